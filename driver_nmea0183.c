@@ -3182,8 +3182,9 @@ static gps_mask_t processSTI(int count, char *field[],
  *
  **************************************************************************/
 
-gps_mask_t nmea_parse(char *sentence, struct gps_device_t * session)
-/* parse an NMEA sentence, unpack it into a session structure */
+gps_mask_t nmea_parse_view(const struct packet_view_t *pkt,
+                           struct gps_device_t * session)
+/* parse an NMEA sentence where the lexer left it, unpack it into a session */
 {
     typedef gps_mask_t(*nmea_decoder) (int count, char *f[],
                                        struct gps_device_t * session);
@@ -3309,16 +3310,15 @@ gps_mask_t nmea_parse(char *sentence, struct gps_device_t * session)
      * legal limit for NMEA, so we can cope by just tossing out overlong
      * packets.  This may be a generic bug of all Garmin chipsets.
      */
-    if (strlen(sentence) > NMEA_MAX) {
+    if (pkt->len > NMEA_MAX) {
         GPSD_LOG(LOG_WARN, &session->context->errout,
-                 "Overlong packet of %zd chars rejected.\n",
-                 strlen(sentence));
+                 "Overlong packet of %zd chars rejected.\n", pkt->len);
         return ONLINE_SET;
     }
 
-    /* make an editable copy of the sentence */
-    (void)strlcpy((char *)session->nmea.fieldcopy, sentence,
-                  sizeof(session->nmea.fieldcopy) - 1);
+    /* make an editable copy of the sentence, the only one */
+    (void)memcpy(session->nmea.fieldcopy, pkt->data, pkt->len);
+    session->nmea.fieldcopy[pkt->len] = '\0';
     /* discard the checksum part */
     for (p = (char *)session->nmea.fieldcopy;
          (*p != '*') && (*p >= ' ');)
@@ -3327,7 +3327,7 @@ gps_mask_t nmea_parse(char *sentence, struct gps_device_t * session)
         *p++ = ',';             /* otherwise we drop the last field */
 #ifdef SKYTRAQ_ENABLE_UNUSED
     /* $STI is special, no trailing *, or chacksum */
-    if ( 0 != strncmp( "STI,", sentence, 4) ) {
+    if ( 0 != strncmp( "STI,", (const char *)pkt->data, 4) ) {
         skytraq_sti = true;
         *p++ = ',';             /* otherwise we drop the last field */
     }
@@ -3539,6 +3539,17 @@ gps_mask_t nmea_parse(char *sentence, struct gps_device_t * session)
     return mask;
 }
 
+gps_mask_t nmea_parse(char *sentence, struct gps_device_t * session)
+/* parse a NUL-terminated NMEA sentence, unpack it into a session structure */
+{
+    struct packet_view_t pkt;
+
+    pkt.type = NMEA_PACKET;
+    pkt.data = (const unsigned char *)sentence;
+    pkt.len = strlen(sentence);
+    return nmea_parse_view(&pkt, session);
+}
+
 #endif /* NMEA0183_ENABLE */
 
 void nmea_add_checksum(char *sentence)
@@ -1451,6 +1451,7 @@ static void find_pgn(struct can_frame *frame, struct gps_device_t *session)
 		    GPSD_LOG(LOG_DATA, &session->context->errout,
 			     "pgn %6d:%s \n", work->pgn, work->name);
 		    session->driver.nmea2000.workpgn = (void *) work;
+		    session->lexer.packet = session->lexer.outbuffer = session->lexer.outbuf;
 		    session->lexer.outbuflen =  frame->can_dlc & 0x0f;
 		    for (l2=0;l2<session->lexer.outbuflen;l2++) {
 		        session->lexer.outbuffer[l2]= frame->data[l2];
@@ -1468,6 +1469,7 @@ static void find_pgn(struct can_frame *frame, struct gps_device_t *session)
 			     frame->data[1],
 			     source_pgn);
 #endif /* of #if NMEA2000_FAST_DEBUG */
+		    session->lexer.inbuffer = session->lexer.inbuf;
 		    session->lexer.inbuflen = 0;
 		    session->driver.nmea2000.idx += 1;
 		    for (l2=2;l2<8;l2++) {
@@ -1494,6 +1496,7 @@ static void find_pgn(struct can_frame *frame, struct gps_device_t *session)
 				                                                   source_pgn);
 #endif /* of #if  NMEA2000_FAST_DEBUG */
 			session->driver.nmea2000.workpgn = (void *) work;
+		        session->lexer.packet = session->lexer.outbuffer = session->lexer.outbuf;
 		        session->lexer.outbuflen = session->driver.nmea2000.fast_packet_len;
 			for(l2=0;l2 < (unsigned int)session->lexer.outbuflen; l2++) {
 			    session->lexer.outbuffer[l2] = session->lexer.inbuffer[l2];
@@ -31,6 +31,7 @@
  * libgpsd_core.c
  * packet.c
  * packet_states.h
+ * packetgen.py
  *
  * This file is Copyright (c) 2010-2018 by the GPSD project
  * SPDX-License-Identifier: BSD-2-clause
@@ -47,11 +48,11 @@
 #include "bits.h"
 
 static	gps_mask_t _proto__parse_input(struct gps_device_t *);
-static	gps_mask_t _proto__dispatch(struct gps_device_t *, unsigned char *, size_t );
-static	gps_mask_t _proto__msg_navsol(struct gps_device_t *, unsigned char *, size_t );
-static	gps_mask_t _proto__msg_utctime(struct gps_device_t *, unsigned char *, size_t );
-static	gps_mask_t _proto__msg_svinfo(struct gps_device_t *, unsigned char *, size_t );
-static	gps_mask_t _proto__msg_raw(struct gps_device_t *, unsigned char *, size_t );
+static	gps_mask_t _proto__dispatch(struct gps_device_t *, const unsigned char *, size_t );
+static	gps_mask_t _proto__msg_navsol(struct gps_device_t *, const unsigned char *, size_t );
+static	gps_mask_t _proto__msg_utctime(struct gps_device_t *, const unsigned char *, size_t );
+static	gps_mask_t _proto__msg_svinfo(struct gps_device_t *, const unsigned char *, size_t );
+static	gps_mask_t _proto__msg_raw(struct gps_device_t *, const unsigned char *, size_t );
 
 /*
  * These methods may be called elsewhere in gpsd
@@ -66,7 +67,7 @@ static	void _proto__set_mode(struct gps_device_t *, int);
  * Decode the navigation solution message
  */
 static gps_mask_t
-_proto__msg_navsol(struct gps_device_t *session, unsigned char *buf, size_t data_len)
+_proto__msg_navsol(struct gps_device_t *session, const unsigned char *buf, size_t data_len)
 {
     gps_mask_t mask;
     int flags;
@@ -145,7 +146,7 @@ _proto__msg_navsol(struct gps_device_t *session, unsigned char *buf, size_t data
  * GPS Leap Seconds
  */
 static gps_mask_t
-_proto__msg_utctime(struct gps_device_t *session, unsigned char *buf, size_t data_len)
+_proto__msg_utctime(struct gps_device_t *session, const unsigned char *buf, size_t data_len)
 {
     double t;
 
@@ -171,7 +172,7 @@ _proto__msg_utctime(struct gps_device_t *session, unsigned char *buf, size_t dat
  * GPS Satellite Info
  */
 static gps_mask_t
-_proto__msg_svinfo(struct gps_device_t *session, unsigned char *buf, size_t data_len)
+_proto__msg_svinfo(struct gps_device_t *session, const unsigned char *buf, size_t data_len)
 {
     unsigned char i, st, nchan, nsv;
     unsigned int tow;
@@ -231,7 +232,7 @@ _proto__msg_svinfo(struct gps_device_t *session, unsigned char *buf, size_t data
  * Raw measurements
  */
 static gps_mask_t
-_proto__msg_raw(struct gps_device_t *session, unsigned char *buf, size_t data_len)
+_proto__msg_raw(struct gps_device_t *session, const unsigned char *buf, size_t data_len)
 {
     unsigned char i, st, nchan, nsv;
     unsigned int tow;
@@ -281,7 +282,7 @@ _proto__msg_raw(struct gps_device_t *session, unsigned char *buf, size_t data_le
 /**
  * Parse the data from the device
  */
-gps_mask_t _proto__dispatch(struct gps_device_t *session, unsigned char *buf, size_t len)
+gps_mask_t _proto__dispatch(struct gps_device_t *session, const unsigned char *buf, size_t len)
 {
     size_t i;
     int type, used, visible, retmask = 0;
@@ -429,11 +430,13 @@ static void _proto__event_hook(struct gps_device_t *session, event_t event)
  */
 static gps_mask_t _proto__parse_input(struct gps_device_t *session)
 {
-    if (session->lexer.type == _PROTO__PACKET) {
-	return _proto__dispatch(session, session->lexer.outbuffer, session->lexer.outbuflen);
+    struct packet_view_t pkt = packet_view(&session->lexer);
+
+    if (pkt.type == _PROTO__PACKET) {
+	return _proto__dispatch(session, pkt.data, pkt.len);
 #ifdef NMEA0183_ENABLE
-    } else if (session->lexer.type == NMEA_PACKET) {
-	return nmea_parse((char *)session->lexer.outbuffer, session);
+    } else if (pkt.type == NMEA_PACKET) {
+	return nmea_parse_view(&pkt, session);
 #endif /* NMEA0183_ENABLE */
     } else
 	return 0;
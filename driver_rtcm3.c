@@ -72,7 +72,7 @@ SPDX-License-Identifier: BSD-2-clause
  * and look at the tklib source: http://www.rtklib.com/
  */
 void rtcm3_unpack(const struct gps_context_t *context,
-                  struct rtcm3_t *rtcm, char *buf)
+                  struct rtcm3_t *rtcm, const char *buf)
 /* break out the raw bits into the scaled report-structure fields */
 {
     unsigned int n, n2, n3, n4;
@@ -62,34 +62,39 @@
 #define UBX_CFG_LEN             20
 #define outProtoMask            14
 
-static gps_mask_t ubx_parse(struct gps_device_t *session, unsigned char *buf,
-                            size_t len);
+static gps_mask_t ubx_parse(struct gps_device_t *session,
+                            const unsigned char *buf, size_t len);
 static gps_mask_t ubx_msg_nav_eoe(struct gps_device_t *session,
-                                  unsigned char *buf, size_t data_len);
+                                  const unsigned char *buf, size_t data_len);
 static gps_mask_t ubx_msg_nav_dop(struct gps_device_t *session,
-                                  unsigned char *buf, size_t data_len);
-static void ubx_msg_inf(struct gps_device_t *session, unsigned char *buf,
+                                  const unsigned char *buf, size_t data_len);
+static void ubx_msg_inf(struct gps_device_t *session, const unsigned char *buf,
                         size_t data_len);
 static gps_mask_t ubx_msg_nav_posecef(struct gps_device_t *session,
-                                      unsigned char *buf, size_t data_len);
+                                      const unsigned char *buf,
+                                      size_t data_len);
 static gps_mask_t ubx_msg_nav_pvt(struct gps_device_t *session,
-                                  unsigned char *buf, size_t data_len);
+                                  const unsigned char *buf, size_t data_len);
 static void ubx_msg_mon_ver(struct gps_device_t *session,
-                                      unsigned char *buf, size_t data_len);
+                                      const unsigned char *buf,
+                                      size_t data_len);
 static gps_mask_t ubx_msg_nav_sat(struct gps_device_t *session,
-                                  unsigned char *buf, size_t data_len);
+                                  const unsigned char *buf, size_t data_len);
 static gps_mask_t ubx_msg_nav_sol(struct gps_device_t *session,
-                                  unsigned char *buf, size_t data_len);
+                                  const unsigned char *buf, size_t data_len);
 static gps_mask_t ubx_msg_nav_svinfo(struct gps_device_t *session,
-                                     unsigned char *buf, size_t data_len);
+                                     const unsigned char *buf,
+                                     size_t data_len);
 static gps_mask_t ubx_msg_nav_timegps(struct gps_device_t *session,
-                                      unsigned char *buf, size_t data_len);
+                                      const unsigned char *buf,
+                                      size_t data_len);
 static gps_mask_t ubx_msg_nav_velecef(struct gps_device_t *session,
-                                      unsigned char *buf, size_t data_len);
-static void ubx_msg_sbas(struct gps_device_t *session, unsigned char *buf,
-                         size_t data_len);
+                                      const unsigned char *buf,
+                                      size_t data_len);
+static void ubx_msg_sbas(struct gps_device_t *session,
+                         const unsigned char *buf, size_t data_len);
 static gps_mask_t ubx_msg_tim_tp(struct gps_device_t *session,
-                                 unsigned char *buf, size_t data_len);
+                                 const unsigned char *buf, size_t data_len);
 #ifdef RECONFIGURE_ENABLE
 static void ubx_mode(struct gps_device_t *session, int mode);
 #endif /* RECONFIGURE_ENABLE */
@@ -264,7 +269,7 @@ static short ubx_to_prn(int ubx_PRN, unsigned char *gnssId,
  * so squish the data hard.
  */
 static void
-ubx_msg_mon_ver(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_mon_ver(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     size_t n = 0;       /* extended info counter */
@@ -320,7 +325,7 @@ ubx_msg_mon_ver(struct gps_device_t *session, unsigned char *buf,
  * UBX-NAV-HPPOSECEF - High Precision Position Solution in ECEF
  */
 static gps_mask_t
-ubx_msg_nav_hpposecef(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_hpposecef(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     gps_mask_t mask = ECEF_SET;
@@ -362,7 +367,7 @@ ubx_msg_nav_hpposecef(struct gps_device_t *session, unsigned char *buf,
  * No mode, so limited usefulness.
  */
 static gps_mask_t
-ubx_msg_nav_hpposllh(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_hpposllh(struct gps_device_t *session, const unsigned char *buf,
                    size_t data_len)
 {
     int version;
@@ -410,7 +415,7 @@ ubx_msg_nav_hpposllh(struct gps_device_t *session, unsigned char *buf,
  * Navigation Position ECEF message
  */
 static gps_mask_t
-ubx_msg_nav_posecef(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_posecef(struct gps_device_t *session, const unsigned char *buf,
                     size_t data_len)
 {
     gps_mask_t mask = ECEF_SET;
@@ -446,7 +451,7 @@ ubx_msg_nav_posecef(struct gps_device_t *session, unsigned char *buf,
  * Not in u-blox 5 or 6, present in u-blox 7
  */
 static gps_mask_t
-ubx_msg_nav_pvt(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_pvt(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     uint8_t valid;
@@ -619,7 +624,7 @@ ubx_msg_nav_pvt(struct gps_device_t *session, unsigned char *buf,
  * HP GNSS only, protver 20+
  */
 static gps_mask_t
-ubx_msg_nav_relposned(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_relposned(struct gps_device_t *session, const unsigned char *buf,
                       size_t data_len)
 {
     int version;
@@ -677,7 +682,7 @@ ubx_msg_nav_relposned(struct gps_device_t *session, unsigned char *buf,
  * Use UBX-NAV-PVT instead
  */
 static gps_mask_t
-ubx_msg_nav_sol(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_sol(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     unsigned int flags;
@@ -782,7 +787,7 @@ ubx_msg_nav_sol(struct gps_device_t *session, unsigned char *buf,
  * Not in u-blox 5
  */
 static void ubx_msg_nav_timels(struct gps_device_t *session,
-                               unsigned char *buf, size_t data_len)
+                               const unsigned char *buf, size_t data_len)
 {
     int version;
     unsigned int flags;
@@ -893,7 +898,7 @@ static void ubx_msg_nav_timels(struct gps_device_t *session,
  * No mode, so limited usefulness
  */
 static gps_mask_t
-ubx_msg_nav_posllh(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_posllh(struct gps_device_t *session, const unsigned char *buf,
                    size_t data_len UNUSED)
 {
     gps_mask_t mask = 0;
@@ -936,7 +941,7 @@ ubx_msg_nav_posllh(struct gps_device_t *session, unsigned char *buf,
  * Dilution of precision message
  */
 static gps_mask_t
-ubx_msg_nav_dop(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_dop(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     if (18 > data_len) {
@@ -973,7 +978,7 @@ ubx_msg_nav_dop(struct gps_device_t *session, unsigned char *buf,
  * Present in u-blox 8 and 9
  */
 static gps_mask_t
-ubx_msg_nav_eoe(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_eoe(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     if (4 > data_len) {
@@ -997,7 +1002,7 @@ ubx_msg_nav_eoe(struct gps_device_t *session, unsigned char *buf,
  * GPS Leap Seconds - UBX-NAV-TIMEGPS
  */
 static gps_mask_t
-ubx_msg_nav_timegps(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_timegps(struct gps_device_t *session, const unsigned char *buf,
                     size_t data_len)
 {
     uint8_t valid;         /* Validity Flags */
@@ -1047,7 +1052,7 @@ ubx_msg_nav_timegps(struct gps_device_t *session, unsigned char *buf,
  * Not in u-blox 5, protocol version 15+
  */
 static gps_mask_t
-ubx_msg_nav_sat(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_sat(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     unsigned int i, nchan, nsv, st, ver;
@@ -1140,7 +1145,7 @@ ubx_msg_nav_sat(struct gps_device_t *session, unsigned char *buf,
  * Not in u-blox 9, use UBX-NAV-SAT instead
  */
 static gps_mask_t
-ubx_msg_nav_svinfo(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_svinfo(struct gps_device_t *session, const unsigned char *buf,
                    size_t data_len)
 {
     unsigned int i, nchan, nsv, st;
@@ -1231,7 +1236,7 @@ ubx_msg_nav_svinfo(struct gps_device_t *session, unsigned char *buf,
  * Velocity Position ECEF message, UBX-NAV-VELECEF
  */
 static gps_mask_t
-ubx_msg_nav_velecef(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_velecef(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     gps_mask_t mask = VECEF_SET;
@@ -1262,7 +1267,7 @@ ubx_msg_nav_velecef(struct gps_device_t *session, unsigned char *buf,
  * protocol versions 15+
  */
 static gps_mask_t
-ubx_msg_nav_velned(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_nav_velned(struct gps_device_t *session, const unsigned char *buf,
                 size_t data_len)
 {
     gps_mask_t mask = VNED_SET;
@@ -1292,8 +1297,8 @@ ubx_msg_nav_velned(struct gps_device_t *session, unsigned char *buf,
  * Not in u-blox 9
  * FIXME: not well decoded...
  */
-static void ubx_msg_sbas(struct gps_device_t *session, unsigned char *buf,
-                         size_t data_len)
+static void ubx_msg_sbas(struct gps_device_t *session,
+                         const unsigned char *buf, size_t data_len)
 {
     unsigned int i, nsv;
     short ubx_PRN;
@@ -1564,7 +1569,7 @@ static gps_mask_t ubx_rxm_rawx(struct gps_device_t *session,
  * Not in u-blox 8 or 9
  */
 static gps_mask_t ubx_rxm_sfrb(struct gps_device_t *session,
-                               unsigned char *buf, size_t data_len)
+                               const unsigned char *buf, size_t data_len)
 {
     unsigned int i, chan, svid;
     uint32_t words[10];
@@ -1589,7 +1594,7 @@ static gps_mask_t ubx_rxm_sfrb(struct gps_device_t *session,
 }
 
 /* UBX-INF-* */
-static void ubx_msg_inf(struct gps_device_t *session, unsigned char *buf,
+static void ubx_msg_inf(struct gps_device_t *session, const unsigned char *buf,
                         size_t data_len)
 {
     unsigned short msgid;
@@ -1634,7 +1639,7 @@ static void ubx_msg_inf(struct gps_device_t *session, unsigned char *buf,
  * Time Pulse Timedata - UBX-TIM-TP
  */
 static gps_mask_t
-ubx_msg_tim_tp(struct gps_device_t *session, unsigned char *buf,
+ubx_msg_tim_tp(struct gps_device_t *session, const unsigned char *buf,
                size_t data_len)
 {
     gps_mask_t mask = ONLINE_SET;
@@ -1701,7 +1706,7 @@ ubx_msg_tim_tp(struct gps_device_t *session, unsigned char *buf,
     return mask;
 }
 
-gps_mask_t ubx_parse(struct gps_device_t * session, unsigned char *buf,
+gps_mask_t ubx_parse(struct gps_device_t * session, const unsigned char *buf,
                      size_t len)
 {
     size_t data_len;
@@ -2075,8 +2080,9 @@ gps_mask_t ubx_parse(struct gps_device_t * session, unsigned char *buf,
 static gps_mask_t parse_input(struct gps_device_t *session)
 {
     if (session->lexer.type == UBX_PACKET) {
-        return ubx_parse(session, session->lexer.outbuffer,
-                         session->lexer.outbuflen);
+        struct packet_view_t pkt = packet_view(&session->lexer);
+
+        return ubx_parse(session, pkt.data, pkt.len);
     } else
         return generic_parse_input(session);
 }
@@ -34,23 +34,26 @@ gps_mask_t generic_parse_input(struct gps_device_t *session)
     } else if (session->lexer.type == NMEA_PACKET) {
 	const struct gps_type_t **dp;
 	gps_mask_t st = 0;
-	char *sentence = (char *)session->lexer.outbuffer;
+	struct packet_view_t pkt = packet_view(&session->lexer);
+	const char *sentence = (const char *)pkt.data;
+	int len = (int)pkt.len;
 
-	if (sentence[strlen(sentence)-1] != '\n')
+	if (sentence[len-1] != '\n')
 	    GPSD_LOG(LOG_IO, &session->context->errout,
-		     "<= GPS: %s\n", sentence);
+		     "<= GPS: %.*s\n", len, sentence);
 	else
 	    GPSD_LOG(LOG_IO, &session->context->errout,
-		     "<= GPS: %s", sentence);
+		     "<= GPS: %.*s", len, sentence);
 
-	if ((st=nmea_parse(sentence, session)) == 0) {
+	if ((st=nmea_parse_view(&pkt, session)) == 0) {
 	    GPSD_LOG(LOG_WARN, &session->context->errout,
-		     "unknown sentence: \"%s\"\n", sentence);
+		     "unknown sentence: \"%.*s\"\n", len, sentence);
 	}
 	for (dp = gpsd_drivers; *dp; dp++) {
 	    char *trigger = (*dp)->trigger;
 
-	    if (trigger!=NULL && str_starts_with(sentence, trigger)) {
+	    if (trigger!=NULL && strlen(trigger) <= pkt.len
+		&& memcmp(sentence, trigger, strlen(trigger)) == 0) {
 		GPSD_LOG(LOG_PROG, &session->context->errout,
 			 "found trigger string %s.\n", trigger);
 		if (*dp != session->device_type) {
@@ -977,12 +980,13 @@ static const struct gps_type_t driver_rtcm104v2 = {
 
 static gps_mask_t rtcm104v3_analyze(struct gps_device_t *session)
 {
-    uint16_t type = getbeu16(session->lexer.inbuffer, 3) >> 4;
+    struct packet_view_t pkt = packet_view(&session->lexer);
+    uint16_t type = getbeu16(pkt.data, 3) >> 4;
 
     GPSD_LOG(LOG_RAW, &session->context->errout, "RTCM 3.x packet %d\n", type);
     rtcm3_unpack(session->context,
 		 &session->gpsdata.rtcm3,
-		 (char *)session->lexer.outbuffer);
+		 (const char *)pkt.data);
     session->cycle_end_reliable = true;
     return RTCM3_SET;
 }
@@ -1372,20 +1376,20 @@ static bool aivdm_decode(const char *buf, size_t buflen,
 
     /* we may need to dump the raw packet */
     GPSD_LOG(LOG_PROG, &session->context->errout,
-	     "AIVDM packet length %zd: %s\n", buflen, buf);
+	     "AIVDM packet length %zd: %.*s\n", buflen, (int)buflen, buf);
 
     /* first clear the result, making sure we don't return garbage */
     memset(ais, 0, sizeof(*ais));
 
     /* discard overlong sentences */
-    if (strlen(buf) > sizeof(fieldcopy)-1) {
+    if (buflen > sizeof(fieldcopy)-1) {
 	GPSD_LOG(LOG_ERROR, &session->context->errout,
 		 "overlong AIVDM packet.\n");
 	return false;
     }
 
     /* discard sentences with high-half characters in them, they're corrupted */
-    for (cp1 = buf; *cp1; cp1++) {
+    for (cp1 = buf; cp1 < buf + buflen; cp1++) {
 	if (!isascii(*cp1)) {
 	    GPSD_LOG(LOG_ERROR, &session->context->errout,
 		     "corrupted AIVDM packet.\n");
@@ -1394,8 +1398,9 @@ static bool aivdm_decode(const char *buf, size_t buflen,
     }
 
     /* extract packet fields */
-    (void)strlcpy((char *)fieldcopy, buf, sizeof(fieldcopy));
-    field[nfields++] = (unsigned char *)buf;
+    (void)memcpy(fieldcopy, buf, buflen);
+    fieldcopy[buflen] = '\0';
+    field[nfields++] = fieldcopy;
     for (cp = fieldcopy;
 	 cp < fieldcopy + buflen; cp++)
     {
@@ -1543,17 +1548,19 @@ static bool aivdm_decode(const char *buf, size_t buflen,
 
 static gps_mask_t aivdm_analyze(struct gps_device_t *session)
 {
-    if (session->lexer.type == AIVDM_PACKET) {
+    struct packet_view_t pkt = packet_view(&session->lexer);
+
+    if (pkt.type == AIVDM_PACKET) {
 	if (aivdm_decode
-	    ((char *)session->lexer.outbuffer, session->lexer.outbuflen,
+	    ((const char *)pkt.data, pkt.len,
 	     session, &session->gpsdata.ais,
 	     session->context->errout.debug)) {
 	    return ONLINE_SET | AIS_SET;
 	} else
 	    return ONLINE_SET;
 #ifdef NMEA0183_ENABLE
-    } else if (session->lexer.type == NMEA_PACKET) {
-	return nmea_parse((char *)session->lexer.outbuffer, session);
+    } else if (pkt.type == NMEA_PACKET) {
+	return nmea_parse_view(&pkt, session);
 #endif /* NMEA0183_ENABLE */
     } else
 	return 0;
@@ -1617,7 +1624,7 @@ static void path_rewrite(struct gps_device_t *session, char *prefix)
 	 prefloc++)
 	if (str_starts_with(prefloc, prefix)) {
 	    char *sfxloc;
-	    char copy[sizeof(session->lexer.outbuffer)+1];
+	    char copy[sizeof(session->lexer.outbuf)+1];
 	    (void)strlcpy(copy,
 			  (char *)session->lexer.outbuffer,
 			  sizeof(copy));
@@ -1628,10 +1635,10 @@ static void path_rewrite(struct gps_device_t *session, char *prefix)
 	    if ((sfxloc = strchr(prefloc, '#')))
 		*sfxloc = '\0';  /* Avoid accumulating multiple device names */
 	    (void)strlcat((char *)session->lexer.outbuffer, "#",
-			  sizeof(session->lexer.outbuffer));
+			  sizeof(session->lexer.outbuf));
 	    (void)strlcat((char *)session->lexer.outbuffer,
 			  copy + (prefloc-(char *)session->lexer.outbuffer),
-			  sizeof(session->lexer.outbuffer));
+			  sizeof(session->lexer.outbuf));
 	}
     session->lexer.outbuflen = strlen((char *)session->lexer.outbuffer);
 }
@@ -1655,12 +1662,12 @@ static gps_mask_t json_pass_packet(struct gps_device_t *session)
 		|| strstr((char *)session->lexer.outbuffer, "DEVICES") != NULL) {
 		session->lexer.outbuffer[session->lexer.outbuflen-1] = '\0';
 		(void)strlcat((char *)session->lexer.outbuffer, ",\"remote\":\"",
-			      sizeof(session->lexer.outbuffer));
+			      sizeof(session->lexer.outbuf));
 		(void)strlcat((char *)session->lexer.outbuffer,
 			      session->gpsdata.dev.path,
-			      sizeof(session->lexer.outbuffer));
+			      sizeof(session->lexer.outbuf));
 		(void)strlcat((char *)session->lexer.outbuffer, "\"}",
-			      sizeof(session->lexer.outbuffer));
+			      sizeof(session->lexer.outbuf));
 	    }
 	    session->lexer.outbuflen = strlen((char *)session->lexer.outbuffer);
 	}
@@ -0,0 +1,552 @@
+/****************************************************************************
+
+NAME
+   eventloop.c - descriptor readiness multiplexing for the daemon
+
+DESCRIPTION
+   The daemon used to keep one fd_set holding every descriptor it cared
+about and hand a copy of it to pselect(2) on each wakeup, then walk all
+FD_SETSIZE bits plus every device and subscriber slot to find out what
+had gone ready.  That scan costs O(FD_SETSIZE) per packet and caps the
+number of clients at FD_SETSIZE.
+
+   This module keeps a registration table indexed by descriptor.  Each
+entry carries a caller-defined tag and data pointer (a device, a
+subscriber, a listening socket...).  gpsd_evloop_wait() hands back only
+the descriptors that are ready, each with its tag and pointer, so the
+caller never has to search for the owner of a descriptor.
+
+   Where epoll(7) is available it is used, and there is no limit on
+descriptor numbers.  Elsewhere we fall back to pselect(2), which keeps
+the old FD_SETSIZE ceiling but presents the same interface.
+
+   Regular files cannot be registered with epoll.  select() reports them
+as always readable, so we do the same: they are kept off the epoll set
+and reported ready on every wait.
+
+   The registration table is guarded by a mutex, so that other threads
+(the PPS thread shipping a message to a client, say) may change the
+events a descriptor is watched for while the main thread sleeps in
+gpsd_evloop_wait().  The lock is never held across the wait itself.
+epoll notices such changes by itself; pselect() only sees the sets it
+was handed, so under it every change made during a wait also writes a
+byte to a wakeup pipe, and the wait starts over with the new sets.
+
+PERMISSIONS
+   This file is Copyright (c) 2020 by the GPSD project
+   SPDX-License-Identifier: BSD-2-clause
+
+***************************************************************************/
+
+#include "gpsd_config.h"  /* must be before all includes */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
+
+#include "gpsd.h"
+#include "strfuncs.h"
+#include "timespec.h"
+
+/* registration slots are added in chunks of this many descriptors */
+#define EVLOOP_CHUNK	64
+
+static pthread_mutex_t evloop_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void evloop_lock(void)
+{
+    (void)pthread_mutex_lock(&evloop_mutex);
+}
+
+static void evloop_unlock(void)
+{
+    (void)pthread_mutex_unlock(&evloop_mutex);
+}
+
+static bool evloop_watched(const struct evloop_t *loop, socket_t fd)
+/* is this descriptor registered?  Caller holds the lock. */
+{
+    return 0 <= fd && fd < loop->nwatches &&
+           EVLOOP_UNUSED != loop->watches[fd].tag;
+}
+
+static bool evloop_grow(struct evloop_t *loop, socket_t fd)
+/* make sure the registration table can be indexed by fd */
+{
+    struct evloop_watch_t *nw;
+    int newlen, i;
+
+    if (fd < loop->nwatches)
+        return true;
+    newlen = (fd / EVLOOP_CHUNK + 1) * EVLOOP_CHUNK;
+    nw = (struct evloop_watch_t *)realloc(loop->watches,
+                                         newlen * sizeof(*nw));
+    if (NULL == nw)
+        return false;
+    for (i = loop->nwatches; i < newlen; i++) {
+        nw[i].events = 0;
+        nw[i].tag = EVLOOP_UNUSED;
+        nw[i].data = NULL;
+        nw[i].always = false;
+    }
+    loop->watches = nw;
+    loop->nwatches = newlen;
+    return true;
+}
+
+static void evloop_changed(struct evloop_t *loop)
+/* the watch set changed; wake a pselect() that can't see it.
+ * Caller holds the lock. */
+{
+    /* a full pipe already means the waiter will look */
+    if (loop->waiting && 0 <= loop->wake[1])
+        ignore_return(write(loop->wake[1], "", 1));
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static uint32_t epoll_mask(unsigned int events)
+/* translate our interest flags to epoll's */
+{
+    uint32_t mask = 0;
+
+    if (0 != (events & EVLOOP_READ))
+        mask |= EPOLLIN;
+    if (0 != (events & EVLOOP_WRITE))
+        mask |= EPOLLOUT;
+    return mask;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+bool gpsd_evloop_init(struct evloop_t *loop, struct gpsd_errout_t *errout)
+/* set up an empty loop; false only on a hard failure */
+{
+    memset(loop, '\0', sizeof(*loop));
+    loop->backend = -1;
+    loop->maxfd = -1;
+    loop->wake[0] = loop->wake[1] = -1;
+    loop->errout = errout;
+#ifdef HAVE_SYS_EPOLL_H
+    loop->backend = epoll_create1(EPOLL_CLOEXEC);
+    if (0 > loop->backend) {
+        GPSD_LOG(LOG_WARN, errout,
+                 "epoll_create1() failed (%s), falling back to pselect()\n",
+                 strerror(errno));
+    } else {
+        GPSD_LOG(LOG_PROG, errout, "event loop using epoll\n");
+        return true;
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+    if (-1 == pipe(loop->wake)) {
+        /* we can still run, only slower to see other threads' changes */
+        GPSD_LOG(LOG_WARN, errout, "can't create wakeup pipe: %s\n",
+                 strerror(errno));
+        loop->wake[0] = loop->wake[1] = -1;
+        return true;
+    }
+    (void)fcntl(loop->wake[0], F_SETFL, O_NONBLOCK);
+    (void)fcntl(loop->wake[1], F_SETFL, O_NONBLOCK);
+    (void)fcntl(loop->wake[0], F_SETFD, FD_CLOEXEC);
+    (void)fcntl(loop->wake[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+void gpsd_evloop_close(struct evloop_t *loop)
+/* release everything the loop owns; registered descriptors stay open */
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (0 <= loop->backend)
+        (void)close(loop->backend);
+#endif /* HAVE_SYS_EPOLL_H */
+    if (0 <= loop->wake[0]) {
+        (void)close(loop->wake[0]);
+        (void)close(loop->wake[1]);
+    }
+    loop->wake[0] = loop->wake[1] = -1;
+    free(loop->watches);
+    loop->watches = NULL;
+    loop->nwatches = 0;
+    loop->count = 0;
+    loop->always = 0;
+    loop->maxfd = -1;
+    loop->backend = -1;
+}
+
+static void evloop_remove(struct evloop_t *loop, socket_t fd)
+/* stop watching fd.  Caller holds the lock. */
+{
+    struct evloop_watch_t *wp;
+
+    if (!evloop_watched(loop, fd))
+        return;
+    wp = &loop->watches[fd];
+#ifdef HAVE_SYS_EPOLL_H
+    if (0 <= loop->backend) {
+        if (wp->always)
+            loop->always--;
+        else
+            /* EBADF here only means the fd was closed first */
+            (void)epoll_ctl(loop->backend, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+    wp->tag = EVLOOP_UNUSED;
+    wp->data = NULL;
+    wp->events = 0;
+    wp->always = false;
+    loop->count--;
+    if (fd == loop->maxfd) {
+        while (0 <= loop->maxfd &&
+               EVLOOP_UNUSED == loop->watches[loop->maxfd].tag)
+            loop->maxfd--;
+    }
+    evloop_changed(loop);
+    GPSD_LOG(LOG_RAW, loop->errout, "evloop: unwatching fd %d\n", fd);
+}
+
+static bool evloop_modify(struct evloop_t *loop, socket_t fd,
+                          unsigned int events)
+/* change the events a watched fd is wanted for.  Caller holds the lock. */
+{
+    struct evloop_watch_t *wp = &loop->watches[fd];
+
+    if (wp->events == events)
+        return true;
+    wp->events = events;
+    evloop_changed(loop);
+#ifdef HAVE_SYS_EPOLL_H
+    if (0 <= loop->backend && !wp->always) {
+        struct epoll_event ev;
+
+        memset(&ev, '\0', sizeof(ev));
+        ev.events = epoll_mask(events);
+        ev.data.fd = fd;
+        if (0 != epoll_ctl(loop->backend, EPOLL_CTL_MOD, fd, &ev)) {
+            GPSD_LOG(LOG_ERROR, loop->errout,
+                     "epoll_ctl(MOD, %d) failed: %s\n",
+                     fd, strerror(errno));
+            return false;
+        }
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+    return true;
+}
+
+static bool evloop_add(struct evloop_t *loop, socket_t fd,
+                       unsigned int events, int tag, void *data)
+/* watch fd for events.  Caller holds the lock. */
+{
+    struct evloop_watch_t *wp;
+    bool fresh = !evloop_watched(loop, fd);
+
+    if (fresh) {
+        if (0 > loop->backend && (int)FD_SETSIZE <= fd) {
+            GPSD_LOG(LOG_ERROR, loop->errout,
+                     "fd %d exceeds FD_SETSIZE %d, can't watch it\n",
+                     fd, (int)FD_SETSIZE);
+            return false;
+        }
+        if (!evloop_grow(loop, fd)) {
+            GPSD_LOG(LOG_ERROR, loop->errout,
+                     "no memory to watch fd %d\n", fd);
+            return false;
+        }
+    }
+    /* re-registration replaces the owner */
+    wp = &loop->watches[fd];
+    if (wp->always)
+        loop->always--;
+    wp->events = events;
+    wp->tag = tag;
+    wp->data = data;
+    wp->always = false;
+#ifdef HAVE_SYS_EPOLL_H
+    if (0 <= loop->backend) {
+        struct epoll_event ev;
+        int status;
+
+        memset(&ev, '\0', sizeof(ev));
+        ev.events = epoll_mask(events);
+        ev.data.fd = fd;
+        /*
+         * ADD even when the fd is already watched.  The kernel drops a
+         * descriptor from the set when it is closed, so a watch may
+         * have outlived its fd and now stand for a new one.
+         */
+        status = epoll_ctl(loop->backend, EPOLL_CTL_ADD, fd, &ev);
+        if (0 != status && EEXIST == errno)
+            status = epoll_ctl(loop->backend, EPOLL_CTL_MOD, fd, &ev);
+        if (0 != status) {
+            if (EPERM != errno) {
+                GPSD_LOG(LOG_ERROR, loop->errout,
+                         "epoll_ctl(ADD, %d) failed: %s\n",
+                         fd, strerror(errno));
+                if (fresh) {
+                    wp->tag = EVLOOP_UNUSED;
+                    wp->data = NULL;
+                    wp->events = 0;
+                } else
+                    evloop_remove(loop, fd);
+                return false;
+            }
+            /* a regular file, which select() would call always ready */
+            wp->always = true;
+            loop->always++;
+        }
+    }
+#endif /* HAVE_SYS_EPOLL_H */
+    if (fresh) {
+        loop->count++;
+        if (fd > loop->maxfd)
+            loop->maxfd = fd;
+    }
+    evloop_changed(loop);
+    GPSD_LOG(LOG_RAW, loop->errout,
+             "evloop: watching fd %d, tag %d, events %#x\n",
+             fd, tag, events);
+    return true;
+}
+
+bool gpsd_evloop_add(struct evloop_t *loop, socket_t fd,
+                     unsigned int events, int tag, void *data)
+/* watch fd for events, reporting them with tag and data */
+{
+    bool ok;
+
+    if (BAD_SOCKET(fd) || 0 > fd)
+        return false;
+    evloop_lock();
+    ok = evloop_add(loop, fd, events, tag, data);
+    evloop_unlock();
+    return ok;
+}
+
+bool gpsd_evloop_modify(struct evloop_t *loop, socket_t fd,
+                        unsigned int events)
+/* change the set of events we are interested in on fd */
+{
+    bool ok = false;
+
+    evloop_lock();
+    if (evloop_watched(loop, fd))
+        ok = evloop_modify(loop, fd, events);
+    evloop_unlock();
+    return ok;
+}
+
+void gpsd_evloop_remove(struct evloop_t *loop, socket_t fd)
+/* stop watching fd; call this before closing it */
+{
+    evloop_lock();
+    evloop_remove(loop, fd);
+    evloop_unlock();
+}
+
+void gpsd_evloop_release(struct evloop_t *loop, socket_t fd, void *data)
+/* stop watching fd, but only if it is still registered to data */
+{
+    evloop_lock();
+    if (evloop_watched(loop, fd) && loop->watches[fd].data == data)
+        evloop_remove(loop, fd);
+    evloop_unlock();
+}
+
+bool gpsd_evloop_watched(const struct evloop_t *loop, socket_t fd)
+/* is this descriptor registered? */
+{
+    bool watched;
+
+    evloop_lock();
+    watched = evloop_watched(loop, fd);
+    evloop_unlock();
+    return watched;
+}
+
+static int evloop_fill(struct evloop_t *loop, struct evloop_event_t *ev,
+                       socket_t fd, unsigned int fired)
+/* fill in one result entry */
+{
+    ev->fd = fd;
+    ev->tag = loop->watches[fd].tag;
+    ev->data = loop->watches[fd].data;
+    ev->events = fired;
+    return 1;
+}
+
+static int evloop_badfds(struct evloop_t *loop,
+                         struct evloop_event_t *events, int maxevents)
+/* pselect() said EBADF: find the stale descriptors and report them */
+{
+    int fd, n = 0;
+
+    for (fd = 0; fd <= loop->maxfd && n < maxevents; fd++) {
+        /*
+         * All we care about here is a cheap, fast, uninterruptible
+         * way to check if a file descriptor is valid.
+         */
+        if (EVLOOP_UNUSED != loop->watches[fd].tag &&
+            -1 == fcntl(fd, F_GETFL, 0)) {
+            n += evloop_fill(loop, &events[n], fd, EVLOOP_BADFD);
+            evloop_remove(loop, fd);
+        }
+    }
+    return n;
+}
+
+int gpsd_evloop_wait(struct evloop_t *loop,
+                     struct evloop_event_t *events, int maxevents,
+                     const timespec_t *timeout)
+/* wait for readiness; return the number of events, 0 if interrupted
+ * or timed out, or -1 on a hard failure */
+{
+    int status, n = 0;
+
+    GPSD_LOG(LOG_RAW + 1, loop->errout, "evloop waits\n");
+#ifdef HAVE_SYS_EPOLL_H
+    if (0 <= loop->backend) {
+        struct epoll_event ready[EVLOOP_MAXEVENTS];
+        int ms = -1, i, fd;
+
+        if (0 < loop->always) {
+            ms = 0;
+        } else if (NULL != timeout) {
+            /* round up, so we never wake early and spin */
+            ms = (int)(timeout->tv_sec * MS_IN_SEC +
+                       (timeout->tv_nsec + 999999) / 1000000);
+        }
+        if (maxevents > EVLOOP_MAXEVENTS)
+            maxevents = EVLOOP_MAXEVENTS;
+
+        errno = 0;
+        status = epoll_wait(loop->backend, ready, maxevents, ms);
+        if (-1 == status) {
+            if (EINTR == errno)
+                return 0;
+            GPSD_LOG(LOG_ERROR, loop->errout,
+                     "epoll_wait: %s\n", strerror(errno));
+            return -1;
+        }
+        evloop_lock();
+        for (i = 0; i < status; i++) {
+            unsigned int fired = 0;
+
+            fd = ready[i].data.fd;
+            if (!evloop_watched(loop, fd))
+                continue;
+            /* hangups and errors look readable to select(); keep that */
+            if (0 != (ready[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                fired |= EVLOOP_READ;
+            if (0 != (ready[i].events & (EPOLLOUT | EPOLLERR)))
+                fired |= EVLOOP_WRITE;
+            fired &= loop->watches[fd].events | EVLOOP_READ;
+            n += evloop_fill(loop, &events[n], fd, fired);
+        }
+        if (0 < loop->always) {
+            for (fd = 0; fd <= loop->maxfd && n < maxevents; fd++)
+                if (EVLOOP_UNUSED != loop->watches[fd].tag &&
+                    loop->watches[fd].always)
+                    n += evloop_fill(loop, &events[n], fd,
+                                     loop->watches[fd].events);
+        }
+        evloop_unlock();
+    } else
+#endif /* HAVE_SYS_EPOLL_H */
+    {
+        fd_set rfds, wfds;
+        int fd, maxfd, nfds;
+
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        evloop_lock();
+        maxfd = loop->maxfd;
+        nfds = maxfd;
+        if (0 <= loop->wake[0]) {
+            FD_SET(loop->wake[0], &rfds);
+            if (loop->wake[0] > nfds)
+                nfds = loop->wake[0];
+            loop->waiting = true;
+        }
+        for (fd = 0; fd <= maxfd; fd++) {
+            if (EVLOOP_UNUSED == loop->watches[fd].tag)
+                continue;
+            if (0 != (loop->watches[fd].events & EVLOOP_READ))
+                FD_SET(fd, &rfds);
+            if (0 != (loop->watches[fd].events & EVLOOP_WRITE))
+                FD_SET(fd, &wfds);
+        }
+        evloop_unlock();
+        /*
+         * pselect(2) is preferable to vanilla select, to eliminate
+         * the once-per-second wakeup when no sensors are attached.
+         * This cuts power consumption.
+         */
+        errno = 0;
+        status = pselect(nfds + 1, &rfds, &wfds, NULL, timeout, NULL);
+        evloop_lock();
+        loop->waiting = false;
+        evloop_unlock();
+        if (-1 == status) {
+            if (EINTR == errno)
+                return 0;
+            if (EBADF == errno) {
+                evloop_lock();
+                n = evloop_badfds(loop, events, maxevents);
+                evloop_unlock();
+                return n;
+            }
+            GPSD_LOG(LOG_ERROR, loop->errout,
+                     "select: %s\n", strerror(errno));
+            return -1;
+        }
+        if (0 <= loop->wake[0] && FD_ISSET(loop->wake[0], &rfds)) {
+            char buf[16];
+
+            /* the sets changed under us; the caller will wait again */
+            while (0 < read(loop->wake[0], buf, sizeof(buf)))
+                continue;
+            FD_CLR(loop->wake[0], &rfds);
+            status--;
+        }
+        evloop_lock();
+        for (fd = 0; fd <= maxfd && n < status && n < maxevents; fd++) {
+            unsigned int fired = 0;
+
+            /* skip anything unregistered while we slept */
+            if (!evloop_watched(loop, fd))
+                continue;
+            if (FD_ISSET(fd, &rfds))
+                fired |= EVLOOP_READ;
+            if (FD_ISSET(fd, &wfds))
+                fired |= EVLOOP_WRITE;
+            if (0 != fired)
+                n += evloop_fill(loop, &events[n], fd, fired);
+        }
+        evloop_unlock();
+    }
+
+    if (loop->errout->debug >= LOG_SPIN) {
+        char dbuf[BUFSIZ];
+        int i;
+
+        dbuf[0] = '\0';
+        for (i = 0; i < n; i++)
+            str_appendf(dbuf, sizeof(dbuf), "%d:%d%s%s ", events[i].fd,
+                        events[i].tag,
+                        (events[i].events & EVLOOP_READ) ? "r" : "",
+                        (events[i].events & EVLOOP_WRITE) ? "w" : "");
+        str_rstrip_char(dbuf, ' ');
+        GPSD_LOG(LOG_SPIN, loop->errout,
+                 "evloop %d of %d fds ready {%s}\n", n, loop->count, dbuf);
+    }
+    return n;
+}
+
+// vim: set expandtab shiftwidth=4
@@ -78,6 +78,11 @@ extern "C" {
  *       Fix rtcm3_1029_t.text length
  *       Add/change many rtcm2 structs
  *       Add/change many rtcm3 structs
+ *       Add binary to gps_policy_t, and WATCH_BINARY
+ *       Add delta to gps_policy_t, and WATCH_DELTA
+ *       Add fields to gps_policy_t
+ *       Add interval and aisinterval to gps_policy_t
+ *       Add compress to gps_policy_t, and WATCH_COMPRESS
  */
 #define GPSD_API_MAJOR_VERSION  9       /* bump on incompatible changes */
 #define GPSD_API_MINOR_VERSION  1       /* bump on compatible changes */
@@ -85,6 +90,7 @@ extern "C" {
 #define MAXCHANNELS     140     /* u-blox 9 tracks 140 signals */
 #define MAXUSERDEVS     4       /* max devices per user */
 #define GPS_PATH_MAX    128     /* for names like /dev/serial/by-id/... */
+#define GPS_FIELDS_MAX  128     /* for a ?WATCH projection, comma-separated */
 
 // normalize degrees to 0 to 359
 #define DEG_NORM(deg) \
@@ -2201,6 +2207,12 @@ struct gps_policy_t {
     bool timing;                        /* requesting timing info */
     bool split24;                       /* requesting split AIS Type 24s */
     bool pps;                           /* requesting PPS in NMEA/raw modes */
+    bool binary;                        /* requesting binary TPV and SKY */
+    bool delta;                         /* requesting TPV and SKY deltas */
+    char fields[GPS_FIELDS_MAX];        /* members wanted, empty for all */
+    double interval;                    /* least seconds between reports */
+    double aisinterval;                 /* ...and between a ship's AIS */
+    bool compress;                      /* requesting a deflated stream */
     int loglevel;                       /* requested log level of messages */
     char devpath[GPS_PATH_MAX];         /* specific device to watch */
     char remote[GPS_PATH_MAX];          /* ...if this was passthrough */
@@ -2244,7 +2256,10 @@ typedef int socket_t;
 #define WATCH_DEVICE    0x000800u       /* watch specific device */
 #define WATCH_SPLIT24   0x001000u       /* split AIS Type 24s */
 #define WATCH_PPS       0x002000u       /* enable PPS JSON */
+#define WATCH_BINARY    0x004000u       /* binary TPV and SKY */
+#define WATCH_DELTA     0x008000u       /* TPV and SKY deltas */
 #define WATCH_NEWSTYLE  0x010000u       /* force JSON streaming */
+#define WATCH_COMPRESS  0x020000u       /* deflate the stream */
 
 /*
  * Main structure that includes all previous substructures
@@ -2477,6 +2492,7 @@ extern void datum_code_string(int code, char *buffer, size_t len);
 #define SHM_NOSHARED    -7      /* shared-memory segment not available */
 #define SHM_NOATTACH    -8      /* shared-memory attach failed */
 #define DBUS_FAILURE    -9      /* DBUS initialization failure */
+#define SHM_BADLAYOUT   -10     /* shared-memory segment layout unknown */
 
 #define DEFAULT_GPSD_PORT       "2947"  /* IANA assignment */
 #define DEFAULT_RTCM_PORT       "2101"  /* IANA assignment */
@@ -2484,6 +2500,9 @@ extern void datum_code_string(int code, char *buffer, size_t len);
 /* special host values for non-socket exports */
 #define GPSD_SHARED_MEMORY      "shared memory"
 #define GPSD_DBUS_EXPORT        "DBUS export"
+#define GPSD_UDP_EXPORT         "udp://"        /* prefix to a group */
+#define GPSD_LOCAL_SOCKET       "unix://"       /* prefix to a socket path */
+#define GPSD_SHM_DEVICE         "shm://"        /* prefix to a record class */
 
 #ifdef __cplusplus
 }  /* End of the 'extern "C"' block */
@@ -32,6 +32,8 @@ void json_oscillator_dump(const struct gps_data_t *, char *, size_t);
 void json_subframe_dump(const struct gps_data_t *, char buf[], size_t);
 void json_device_dump(const struct gps_device_t *, char *, size_t);
 void json_watch_dump(const struct gps_policy_t *, char *, size_t);
+bool json_delta(const char *, const char *, char *, size_t);
+bool json_project(const char *, const char *, char *, size_t);
 int json_watch_read(const char *, struct gps_policy_t *,
 		    const char **);
 int json_device_read(const char *, struct devconfig_t *,
@@ -47,6 +49,31 @@ int json_ais_read(const char *, char *, size_t, struct ais_t *,
 		  const char **);
 int libgps_json_unpack(const char *, struct gps_data_t *,
 		       const char **);
+
+/*
+ * Binary reports, sent in place of TPV and SKY to watchers that asked
+ * for "binary":true.  A record is the magic byte, a type byte, the
+ * device path as a length byte and that many bytes, a little-endian
+ * 16-bit body length, then the body.  The path comes first so that
+ * reports superseding one another share a prefix, as JSON ones do.
+ */
+#define BINARY_MAGIC		0xb5	/* never starts a JSON or NMEA line */
+#define BINARY_TPV		'T'
+#define BINARY_SKY		'S'
+#define BINARY_TPV_FIELDS	35
+
+/* the TPV body's optional doubles, in bitmap order */
+struct binary_field_t {
+    size_t offset;		/* into struct gps_fix_t */
+    int mode;			/* least fix mode at which it is sent */
+};
+extern const struct binary_field_t binary_tpv_fields[BINARY_TPV_FIELDS];
+
+size_t binary_data_report(const gps_mask_t,
+			  const struct gps_device_t *,
+			  char *, size_t);
+ssize_t binary_record_length(const char *, size_t);
+int libgps_binary_unpack(const char *, size_t, struct gps_data_t *);
 #ifdef __cplusplus
 }
 #endif
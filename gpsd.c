@@ -30,6 +30,7 @@
 #include <sys/param.h>    /* for setgroups() */
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>      /* for writev() */
 #include <sys/un.h>
 #include <time.h>
 #include <unistd.h>       /* for setgroups() */
@@ -40,6 +41,9 @@
 #ifndef INADDR_ANY
 #include <netinet/in.h>
 #endif /* INADDR_ANY */
+#ifdef ZLIB_ENABLE
+#include <zlib.h>
+#endif /* ZLIB_ENABLE */
 
 #include "gpsd.h"
 #include "gps_json.h"         /* needs gpsd.h */
@@ -67,8 +71,8 @@
  * that open connections and just sit there, not issuing a WATCH or
  * doing anything else that triggers a device assignment.  Clients
  * in watcher or raw mode that don't read their data will get dropped
- * when throttled_write() fills up the outbound buffers and the
- * NOREAD_TIMEOUT expires.
+ * when throttled_write() has had output queued for them and the queue
+ * has made no progress before NOREAD_TIMEOUT expires.
  *
  * RELEASE_TIMEOUT sets the amount of time we hold a device
  * open after the last subscriber closes it; this is nonzero so a
@@ -87,12 +91,17 @@
  *
  * DEVICE_RECONNECT sets interval on retries when (re)connecting to
  * a device.
+ *
+ * POLL_PACKETS is the default number of packets one device may have
+ * handled per pass of the main loop before the others get a turn
+ * (-B), so that a chatty source cannot starve a quiet one.
  */
 #define COMMAND_TIMEOUT		60*15
 #define NOREAD_TIMEOUT		60*3
 #define RELEASE_TIMEOUT		60
 #define DEVICE_REAWAKE		0.01
 #define DEVICE_RECONNECT	2
+#define POLL_PACKETS		8
 
 #define QLEN			5
 
@@ -127,8 +136,16 @@ static const int af_allowed = AF_UNSPEC;
 
 #define AFCOUNT 2
 
-static fd_set all_fds;
-static int maxfd;
+/* what a descriptor in the event loop belongs to */
+enum watch_kind_t {
+    watch_listener,		/* listening socket for clients */
+    watch_client,		/* client connection, data is the subscriber */
+    watch_device,		/* data source, data is the device */
+    watch_control_listener,	/* listening control socket */
+    watch_control,		/* control socket connection */
+};
+
+static struct evloop_t evloop;
 static int highwater;
 #ifndef FORCE_GLOBAL_ENABLE
 static bool listen_global = false;
@@ -208,6 +225,8 @@ static void usage(void)
 {
     (void)printf("usage: gpsd [OPTIONS] device...\n\n\
   Options include: \n\
+  -B PACKETS[,BYTES]        = handle at most PACKETS packets (and BYTES\n\
+                              bytes) per device per pass, 0 for no limit\n\
   -b		     	    = bluetooth-safe: open data sources read-only\n\
   -D integer (default 0)    = set debug level \n\
   -F sockfile		    = specify control socket location\n\
@@ -216,17 +235,28 @@ static void usage(void)
 #ifndef FORCE_GLOBAL_ENABLE
 "                             forced on in this binary\n"
 #endif /* FORCE_GLOBAL_ENABLE */
-"  -h		     	    = help message \n\
-  -n			    = don't wait for client connects to poll GPS\n"
+"  -h		     	    = help message \n"
+#if defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET)
+"  -L sockfile               = also take clients on a local socket that\n\
+                              keeps message boundaries\n"
+#endif /* defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET) */
+"  -n			    = don't wait for client connects to poll GPS\n"
 #ifdef FORCE_NOWAIT
 "                             forced on in this binary\n"
 #endif /* FORCE_NOWAIT */
 "  -N			    = don't go into background\n\
   -P pidfile	      	    = set file to record process ID\n\
+  -Q SIZE[,POLICY]          = queue up to SIZE bytes per client, dropping\n\
+                              the oldest output (POLICY drop, default)\n\
+                              or superseded reports (POLICY coalesce)\n\
   -r               	    = use GPS time even if no fix\n\
   -S PORT (default %s) = set port for daemon \n\
-  -s SPEED                  = fix device speed to SPEED\n\
-  -V			    = emit version and exit.\n"
+  -s SPEED                  = fix device speed to SPEED\n"
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+"  -U GROUP[:PORT]           = also send JSON reports to a multicast or\n\
+                              broadcast group\n"
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
+"  -V			    = emit version and exit.\n"
 #ifdef NETFEED_ENABLE
 "\nA device may be a local serial device for GNSS input, plus an optional\n\
 PPS device, or a URL in one of the following forms:\n\
@@ -247,15 +277,17 @@ The following driver types are compiled into this gpsd instance:\n",
 
 }
 
-#ifdef CONTROL_SOCKET_ENABLE
-static socket_t filesock(char *filename)
+#if defined(CONTROL_SOCKET_ENABLE) || \
+    (defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET))
+static socket_t filesock(char *filename, int type)
+/* listen on a Unix-domain socket of the given type */
 {
     struct sockaddr_un addr;
     socket_t sock;
 
-    if (BAD_SOCKET(sock = socket(AF_UNIX, SOCK_STREAM, 0))) {
+    if (BAD_SOCKET(sock = socket(AF_UNIX, type, 0))) {
 	GPSD_LOG(LOG_ERROR, &context.errout,
-		 "Can't create device-control socket\n");
+		 "Can't create local socket %s\n", filename);
 	return -1;
     }
     (void)strlcpy(addr.sun_path, filename, sizeof(addr.sun_path));
@@ -276,9 +308,9 @@ static socket_t filesock(char *filename)
     /* coverity[leaked_handle] This is an intentional allocation */
     return sock;
 }
-#endif /* CONTROL_SOCKET_ENABLE */
+#endif /* CONTROL_SOCKET_ENABLE || (SOCKET_EXPORT_ENABLE && SOCK_SEQPACKET) */
 
-#define sub_index(s) (int)((s) - subscribers)
+#define sub_index(s) ((s)->index)
 #define allocated_device(devp)	 ((devp)->gpsdata.dev.path[0] != '\0')
 #define free_device(devp)	 (devp)->gpsdata.dev.path[0] = '\0'
 #define initialized_device(devp) ((devp)->context != NULL)
@@ -289,19 +321,23 @@ static socket_t filesock(char *filename)
  */
 static struct gps_device_t devices[MAX_DEVICES];
 
-static void adjust_max_fd(int fd, bool on)
-/* track the largest fd currently in use */
+static void device_watch(struct gps_device_t *device, bool on)
+/* start or stop listening to a device's descriptor */
 {
-    if (on) {
-	if (fd > maxfd)
-	    maxfd = fd;
-    } else if (fd == maxfd) {
-        int tfd;
+    socket_t fd = device->gpsdata.gps_fd;
 
-        for (maxfd = tfd = 0; tfd < (int)FD_SETSIZE; tfd++)
-            if (FD_ISSET(tfd, &all_fds))
-                maxfd = tfd;
-    }
+    if (0 > fd)
+	return;
+    if (on)
+	(void)gpsd_evloop_add(&evloop, fd, EVLOOP_READ, watch_device, device);
+    else
+	gpsd_evloop_release(&evloop, fd, device);
+}
+
+static void device_closing(struct gps_device_t *device)
+/* libgpsd is about to close the descriptor, which may then be reused */
+{
+    device_watch(device, false);
 }
 
 #ifdef SOCKET_EXPORT_ENABLE
@@ -496,17 +532,247 @@ static int passivesocks(char *service, char *tcp_or_udp,
 }
 /* *INDENT-ON* */
 
+/*
+ * Output queueing.  When a client's socket won't take a whole report,
+ * whatever is left is queued and written out when the socket becomes
+ * writable again.  The queue is bounded in bytes (queue_limit, -Q) and
+ * in messages (QUEUE_SLOTS).  The ring holding the messages is only
+ * allocated once something is queued, and grows with the backlog, so
+ * prompt clients carry no more than a few slots.  On overflow the
+ * oldest queued messages are discarded.  With the coalesce policy, a
+ * TPV, SKY, GST or ATT report also replaces any unsent one of the same
+ * class from the same device, so a slow client gets the latest state
+ * rather than a backlog.
+ * Text output is queued one line at a time so that discarding never
+ * leaves half a JSON object on the wire.
+ *
+ * Output is also gathered here on its way out.  Everything the main
+ * thread produces for a client in one pass of the main loop (replies,
+ * TPV, SKY, TOFF, ...) is queued, and flush_batched() hands it to the
+ * socket with one writev() per client at the end of the pass.  A client
+ * whose batch reaches FLUSH_IOV messages, or whose queue passes half its
+ * byte limit, is flushed at once instead, so that a busy pass can't
+ * overflow a queue the socket would have kept empty.  Only messages
+ * left over from an earlier flush count as backlog for the coalescing
+ * policy.  Other threads, meaning the PPS thread, flush at
+ * once so that time messages are never held back.
+ */
+#define QUEUE_SLOTS		256	/* most messages queued per client */
+#define QUEUE_CHUNK		8	/* messages in a first ring */
+#define FLUSH_IOV		64	/* most messages per writev() */
+#define QUEUE_LIMIT_DEFAULT	65536	/* default byte limit per client */
+#define QUEUE_LIMIT_MIN		(GPS_JSON_RESPONSE_MAX * 4)
+
+enum queue_policy_t {queue_drop, queue_coalesce};
+
+static size_t queue_limit = QUEUE_LIMIT_DEFAULT;
+static enum queue_policy_t queue_policy = queue_drop;
+
+/*
+ * Raw packets go byte for byte, or hexdumped, to every raw subscriber of
+ * a device, so each rendering is made once per packet into a reference
+ * counted buffer, and the queue of each subscriber points into that
+ * rather than holding a copy.  The PPS thread may flush a queue, and so
+ * drop a reference, while the main thread is queueing, hence the lock.
+ */
+struct shared_t
+{
+    unsigned int refs;		  /* queued messages, plus the maker's */
+    size_t len;
+    char data[];
+};
+
+static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct outmsg_t
+{
+    char *data;
+    struct shared_t *shared;	  /* data is in this, if not NULL */
+    size_t len;
+    size_t sent;		  /* bytes of data already written */
+    size_t keylen;		  /* length of coalescing key, 0 if none */
+#ifdef ZLIB_ENABLE
+    bool deflate;		  /* goes out through the deflater */
+#endif /* ZLIB_ENABLE */
+};
+
+struct outqueue_t
+{
+    struct outmsg_t *msg;	  /* ring, grown as needed, NULL if empty */
+    unsigned int slots;		  /* allocated length of msg[] */
+    unsigned int first;		  /* ring index of the oldest message */
+    unsigned int count;		  /* messages queued */
+    unsigned int fresh;		  /* of those, queued since the last flush */
+    size_t bytes;		  /* unwritten bytes queued */
+    size_t maxbytes;		  /* high-water mark of bytes */
+    unsigned long dropped;	  /* messages discarded on overflow */
+    unsigned long coalesced;	  /* messages superseded by newer ones */
+    time_t progress;		  /* when the queue last drained any */
+};
+
+/* a dropped delta leaves the client wrong until it has whole reports
+ * of both delta classes, TPV and SKY, see delta_classes[] */
+#define DELTA_WHOLE_ALL	0x03
+
+/* report classes in which the newest report supersedes the others */
+#define SUPERSEDING	4
+static const char *const superseding[SUPERSEDING] = {
+    "TPV", "SKY", "GST", "ATT",
+};
+
+#ifdef ZLIB_ENABLE
+/*
+ * A client that asks for "compress" in ?WATCH gets everything after the
+ * WATCH response as one zlib stream.  Messages are queued plain, so the
+ * drop and coalesce policies work as usual, and are deflated only when
+ * the socket can take them, ending each batch with a sync flush so the
+ * client can decode every report as soon as it arrives.  The compression
+ * history carries over from batch to batch, which is where the repeated
+ * keys, class names and device paths go.
+ */
+#define DEFLATE_OUT	(GPS_JSON_RESPONSE_MAX * 4)
+/* zlib's worst case for n bytes, with room for the sync flush */
+#define DEFLATE_BOUND(n)	((n) + ((n) >> 12) + ((n) >> 14) + 32)
+
+struct deflater_t
+{
+    z_stream z;
+    unsigned char *out;		  /* compressed, not yet written */
+    size_t size;		  /* allocated */
+    size_t len;			  /* compressed */
+    size_t sent;		  /* of those, written */
+};
+#endif /* ZLIB_ENABLE */
+
+struct ais_due_t
+{
+    unsigned int mmsi;
+    double due;
+};
+
 struct subscriber_t
 {
     int fd;			  /* client file descriptor. -1 if unused */
     time_t active;		  /* when subscriber last polled for data */
     struct gps_policy_t policy;	  /* configurable bits */
-    pthread_mutex_t mutex;	  /* serialize access to fd */
+    pthread_mutex_t mutex;	  /* serialize access to fd and queue */
+    struct outqueue_t queue;	  /* output the socket hasn't taken yet */
+    int index;			  /* slot number, for log messages */
+    int slot;			  /* position in clients[], -1 if free */
+    struct subscriber_t *next;	  /* next on the free list */
+    int watchlist;		  /* which watchers[] list, -1 if none */
+    int wslot;			  /* position in that list */
+    bool batched;		  /* on the batched[] list to be flushed */
+    bool framed;		  /* socket keeps message boundaries */
+    unsigned int delta_whole;	  /* delta classes to next send whole */
+    double due[MAX_DEVICES][SUPERSEDING];  /* next report per class */
+    struct ais_due_t *aisdue;	  /* and per ship, if wanted */
+#ifdef ZLIB_ENABLE
+    struct deflater_t *deflater;  /* compressing output, if not NULL */
+#endif /* ZLIB_ENABLE */
 };
 
 #define subscribed(sub, devp)    (sub->policy.watcher && (sub->policy.devpath[0]=='\0' || strcmp(sub->policy.devpath, devp->gpsdata.dev.path)==0))
 
-static struct subscriber_t subscribers[MAX_CLIENTS];	/* indexed by client file descriptor */
+/*
+ * Subscriber structures are allocated one at a time and never freed,
+ * so pointers to them stay good; a finished one goes on a free list
+ * for reuse.  clients[] is a dense list of those currently allocated,
+ * so walking it costs in proportion to the connected clients rather
+ * than to the most there have ever been.  Removal swaps the last entry
+ * into the hole, which means a loop that may detach the client it is
+ * looking at has to walk clients[] from the end down.
+ *
+ * The PPS thread walks the list too, so changes to it and walks of it
+ * hold clients_mutex.  That is recursive, because detaching a client
+ * in the middle of a walk is normal.  Take it before any
+ * subscriber's own mutex.
+ *
+ * If MAX_CLIENTS is nonzero, it caps the number of clients.
+ */
+#ifndef MAX_CLIENTS
+#define MAX_CLIENTS	0
+#endif
+#define CLIENTS_CHUNK	64		/* clients[] grows by this much */
+
+static struct subscriber_t **clients;	/* allocated subscribers */
+static int nclients;			/* entries in use in clients[] */
+static int maxclients;			/* allocated length of clients[] */
+static int nsubscribers;		/* subscriber structures made */
+static struct subscriber_t *free_subscribers;
+static pthread_mutex_t clients_mutex;
+/* clients with output gathered this pass; main thread only */
+static struct subscriber_t **batched;
+static int nbatched, maxbatched;
+static pthread_t main_thread;
+
+static void lock_clients(void)
+{
+    (void)pthread_mutex_lock(&clients_mutex);
+}
+
+static void unlock_clients(void)
+{
+    (void)pthread_mutex_unlock(&clients_mutex);
+}
+
+/*
+ * Watcher index.  watchers[n] lists the clients watching devices[n]
+ * by name, and watchers[WATCH_ALL] those watching every device, so a
+ * report goes only to the clients that want it without a strcmp()
+ * per client.  A client's entry is recomputed whenever its policy
+ * changes; a device's list is rebuilt when a device takes over its
+ * slot.  A client watching a device that isn't in the pool yet is on
+ * no list until the device turns up.  The lists are guarded by
+ * clients_mutex and have the same walk-backwards rule as clients[].
+ */
+#define WATCH_ALL	MAX_DEVICES
+
+struct watchlist_t
+{
+    struct subscriber_t **subs;
+    int count;
+    int size;
+};
+
+static struct watchlist_t watchers[MAX_DEVICES + 1];
+
+static void watch_remove(struct subscriber_t *sub)
+/* take a client off whatever watcher list it is on */
+{
+    struct watchlist_t *wl;
+
+    if (0 > sub->watchlist)
+	return;
+    wl = &watchers[sub->watchlist];
+    wl->subs[sub->wslot] = wl->subs[--wl->count];
+    wl->subs[sub->wslot]->wslot = sub->wslot;
+    sub->watchlist = -1;
+}
+
+static void watch_add(struct subscriber_t *sub, int list)
+/* put a client on a watcher list */
+{
+    struct watchlist_t *wl = &watchers[list];
+
+    watch_remove(sub);
+    if (wl->count == wl->size) {
+	struct subscriber_t **grown;
+
+	grown = realloc(wl->subs, (wl->size + CLIENTS_CHUNK) * sizeof(*grown));
+	if (NULL == grown) {
+	    GPSD_LOG(LOG_ERROR, &context.errout,
+		     "no memory to index client(%d) as a watcher\n",
+		     sub_index(sub));
+	    return;
+	}
+	wl->subs = grown;
+	wl->size += CLIENTS_CHUNK;
+    }
+    sub->watchlist = list;
+    sub->wslot = wl->count;
+    wl->subs[wl->count++] = sub;
+}
 
 static void lock_subscriber(struct subscriber_t *sub)
 {
@@ -521,30 +787,495 @@ static void unlock_subscriber(struct subscriber_t *sub)
 static struct subscriber_t *allocate_client(void)
 /* return the address of a subscriber structure allocated for a new session */
 {
-    int si;
+    struct subscriber_t *sub;
 
 #if UNALLOCATED_FD == 0
 #error client allocation code will fail horribly
 #endif
-    for (si = 0; si < NITEMS(subscribers); si++) {
-	if (subscribers[si].fd == UNALLOCATED_FD) {
-	    subscribers[si].fd = 0;	/* mark subscriber as allocated */
-	    return &subscribers[si];
+    lock_clients();
+    if (0 < MAX_CLIENTS && nclients >= MAX_CLIENTS) {
+	unlock_clients();
+	return NULL;
+    }
+    if (nclients == maxclients) {
+	struct subscriber_t **grown;
+
+	grown = realloc(clients,
+			(maxclients + CLIENTS_CHUNK) * sizeof(*clients));
+	if (NULL == grown) {
+	    unlock_clients();
+	    return NULL;
 	}
+	clients = grown;
+	maxclients += CLIENTS_CHUNK;
     }
-    return NULL;
+    if (NULL != free_subscribers) {
+	sub = free_subscribers;
+	free_subscribers = sub->next;
+    } else {
+	sub = calloc(1, sizeof(*sub));
+	if (NULL == sub) {
+	    unlock_clients();
+	    return NULL;
+	}
+	(void)pthread_mutex_init(&sub->mutex, NULL);
+	sub->index = nsubscribers++;
+    }
+    sub->fd = 0;			/* mark subscriber as allocated */
+    sub->active = 0;
+    sub->next = NULL;
+    sub->watchlist = -1;
+    sub->batched = false;
+    sub->slot = nclients;
+    clients[nclients++] = sub;
+    unlock_clients();
+    return sub;
+}
+
+static void release_client(struct subscriber_t *sub)
+/* take a subscriber off the client list and put it on the free list */
+{
+    lock_clients();
+    if (0 <= sub->slot) {
+	clients[sub->slot] = clients[--nclients];
+	clients[sub->slot]->slot = sub->slot;
+	sub->slot = -1;
+	sub->next = free_subscribers;
+	free_subscribers = sub;
+    }
+    unlock_clients();
+}
+
+static size_t coalesce_key(const char *buf, size_t len)
+/* length of the class and device prefix of a report that a newer one
+ * with the same prefix supersedes; 0 if the message must be kept */
+{
+    const char *cp = buf + 10, *end = buf + len;
+    unsigned int i;
+
+    /* binary TPV and SKY records: magic, type, then the device path */
+    if (3 <= len && BINARY_MAGIC == (unsigned char)buf[0]
+	&& (BINARY_TPV == buf[1] || BINARY_SKY == buf[1]))
+	return 3 + (unsigned char)buf[2];
+    if (len < 32 || !str_starts_with(buf, "{\"class\":\""))
+	return 0;
+    for (i = 0; i < SUPERSEDING; i++)
+	if (0 == strncmp(cp, superseding[i], 3) && '"' == cp[3])
+	    break;
+    if (SUPERSEDING == i)
+	return 0;
+    cp += 4;
+    /* a delta depends on every one before it */
+    if (str_starts_with(cp, ",\"delta\":"))
+	return 0;
+    if (!str_starts_with(cp, ",\"device\":\""))
+	return (size_t)(cp - buf);
+    cp += 11;
+    cp = memchr(cp, '"', (size_t)(end - cp));
+    if (NULL == cp)
+	return 0;
+    return (size_t)(cp - buf) + 1;
+}
+
+static struct shared_t *shared_new(const char *buf, size_t len)
+/* a buffer for several queues to share; the caller holds one reference */
+{
+    struct shared_t *sp = malloc(sizeof(*sp) + len);
+
+    if (NULL == sp)
+	return NULL;
+    sp->refs = 1;
+    sp->len = len;
+    memcpy(sp->data, buf, len);
+    return sp;
+}
+
+static void shared_release(struct shared_t *sp)
+/* drop a reference to a shared buffer, freeing it with the last */
+{
+    unsigned int refs;
+
+    if (NULL == sp)
+	return;
+    (void)pthread_mutex_lock(&shared_mutex);
+    refs = --sp->refs;
+    (void)pthread_mutex_unlock(&shared_mutex);
+    if (0 == refs)
+	free(sp);
+}
+
+static void outmsg_free(struct outmsg_t *mp)
+/* release the data of a message leaving the queue */
+{
+    if (NULL != mp->shared)
+	shared_release(mp->shared);
+    else
+	free(mp->data);
+}
+
+static void queue_remove(struct outqueue_t *q, unsigned int i)
+/* drop the i-th oldest queued message */
+{
+    struct outmsg_t *mp = &q->msg[(q->first + i) % q->slots];
+
+    q->bytes -= mp->len - mp->sent;
+    outmsg_free(mp);
+    if (i + q->fresh >= q->count)
+	q->fresh--;
+    for (; i + 1 < q->count; i++)
+	q->msg[(q->first + i) % q->slots] =
+	    q->msg[(q->first + i + 1) % q->slots];
+    q->count--;
+}
+
+static void queue_clear(struct outqueue_t *q)
+/* discard everything queued, and the statistics */
+{
+    while (q->count > 0)
+	queue_remove(q, 0);
+    free(q->msg);
+    memset(q, '\0', sizeof(*q));
+}
+
+static bool queue_grow(struct outqueue_t *q)
+/* make sure the ring has room for one more message */
+{
+    struct outmsg_t *grown;
+    unsigned int i, slots;
+
+    if (q->count < q->slots)
+	return true;
+    slots = (0 == q->slots) ? QUEUE_CHUNK : q->slots * 2;
+    if (slots > QUEUE_SLOTS)
+	slots = QUEUE_SLOTS;
+    if (slots <= q->slots
+	|| NULL == (grown = malloc(slots * sizeof(*grown))))
+	return false;
+    /* unwrap the ring as we go */
+    for (i = 0; i < q->count; i++)
+	grown[i] = q->msg[(q->first + i) % q->slots];
+    free(q->msg);
+    q->msg = grown;
+    q->slots = slots;
+    q->first = 0;
+    return true;
+}
+
+static void queue_append(struct subscriber_t *sub,
+			 const char *buf, size_t len, size_t sent,
+			 struct shared_t *shared)
+/* queue one message, making room per policy; caller holds sub's lock.
+ * A message in a shared buffer is queued by reference, not copied */
+{
+    struct outqueue_t *q = &sub->queue;
+    struct outmsg_t *mp;
+    size_t keylen = 0;
+    unsigned int i;
+
+    /* raw packets are never reports, whatever their first bytes */
+    if (queue_coalesce == queue_policy && 0 == sent && NULL == shared)
+	keylen = coalesce_key(buf, len);
+    if (keylen > 0)
+	for (i = 0; i + q->fresh < q->count; i++) {
+	    mp = &q->msg[(q->first + i) % q->slots];
+	    if (0 == mp->sent && keylen == mp->keylen
+		&& 0 == memcmp(mp->data, buf, keylen)) {
+		queue_remove(q, i);
+		q->coalesced++;
+		break;
+	    }
+	}
+
+    /* make room, oldest first, but never cut a partly written message */
+    while (q->count > 0
+	   && (QUEUE_SLOTS == q->count
+	       || q->bytes + len - sent > queue_limit)) {
+	i = (0 < q->msg[q->first].sent) ? 1 : 0;
+	if (i >= q->count)
+	    break;
+	queue_remove(q, i);
+	q->dropped++;
+    }
+    if (q->count > 0
+	&& (QUEUE_SLOTS == q->count || q->bytes + len - sent > queue_limit)) {
+	q->dropped++;
+	return;
+    }
+
+    if (!queue_grow(q)) {
+	q->dropped++;
+	return;
+    }
+    mp = &q->msg[(q->first + q->count) % q->slots];
+    if (NULL != shared) {
+	(void)pthread_mutex_lock(&shared_mutex);
+	shared->refs++;
+	(void)pthread_mutex_unlock(&shared_mutex);
+	mp->data = (char *)buf;
+    } else if (NULL != (mp->data = malloc(len)))
+	memcpy(mp->data, buf, len);
+    else {
+	q->dropped++;
+	return;
+    }
+    mp->shared = shared;
+    mp->len = len;
+#ifdef ZLIB_ENABLE
+    mp->deflate = NULL != sub->deflater;
+#endif /* ZLIB_ENABLE */
+    mp->sent = sent;
+    mp->keylen = keylen;
+    q->fresh++;
+    if (0 == q->count++)
+	q->progress = time(NULL);
+    q->bytes += len - sent;
+    if (q->bytes > q->maxbytes)
+	q->maxbytes = q->bytes;
+}
+
+static void queue_push(struct subscriber_t *sub,
+		       const char *buf, size_t len, size_t sent,
+		       struct shared_t *shared)
+/* queue_append(), noting any loss that leaves a delta client wrong */
+{
+    unsigned long dropped = sub->queue.dropped;
+
+    queue_append(sub, buf, len, sent, shared);
+    if (dropped != sub->queue.dropped && sub->policy.delta)
+	sub->delta_whole = DELTA_WHOLE_ALL;
+}
+
+static size_t report_length(const char *buf, size_t len)
+/* length of the first report in buf, so each can stand alone */
+{
+    size_t n = len;
+
+    /* JSON objects end at line ends */
+    if ('{' == buf[0]) {
+	const char *nl = memchr(buf, '\n', len);
+	if (NULL != nl)
+	    n = (size_t)(nl - buf) + 1;
+    } else if (BINARY_MAGIC == (unsigned char)buf[0]) {
+	/* and binary reports at record ends */
+	ssize_t reclen = binary_record_length(buf, len);
+	if (0 < reclen && (size_t)reclen <= len)
+	    n = (size_t)reclen;
+    }
+    return n;
+}
+
+static void queue_output(struct subscriber_t *sub,
+			 const char *buf, size_t len, size_t sent)
+/* queue output, the first sent bytes of which are already written */
+{
+    while (len > 0) {
+	size_t n = report_length(buf, len);
+
+	if (sent >= n)
+	    sent -= n;
+	else {
+	    queue_push(sub, buf, n, sent, NULL);
+	    sent = 0;
+	}
+	buf += n;
+	len -= n;
+    }
+}
+
+#ifdef ZLIB_ENABLE
+static bool deflate_start(struct subscriber_t *sub)
+/* compress everything queued for sub from now on */
+{
+    struct deflater_t *dp = calloc(1, sizeof(*dp));
+
+    if (NULL == dp)
+	return false;
+    if (NULL == (dp->out = malloc(DEFLATE_OUT))) {
+	free(dp);
+	return false;
+    }
+    dp->size = DEFLATE_OUT;
+    if (Z_OK != deflateInit(&dp->z, Z_DEFAULT_COMPRESSION)) {
+	free(dp->out);
+	free(dp);
+	return false;
+    }
+    lock_subscriber(sub);
+    sub->deflater = dp;
+    unlock_subscriber(sub);
+    return true;
+}
+
+static void deflate_end(struct subscriber_t *sub)
+/* drop the compression state of a departing client */
+{
+    if (NULL == sub->deflater)
+	return;
+    (void)deflateEnd(&sub->deflater->z);
+    free(sub->deflater->out);
+    free(sub->deflater);
+    sub->deflater = NULL;
+}
+
+static bool deflate_pending(const struct subscriber_t *sub)
+/* is there compressed output to write, or queued output to compress? */
+{
+    const struct outqueue_t *q = &sub->queue;
+
+    return NULL != sub->deflater
+	   && (sub->deflater->sent < sub->deflater->len
+	       || (0 < q->count && q->msg[q->first].deflate));
+}
+
+static int deflate_flush(struct subscriber_t *sub)
+/* compress a batch from the head of the queue and write it; caller
+ * holds sub's lock.  1 if all went, 0 if the socket is full, -1 on
+ * error */
+{
+    struct deflater_t *dp = sub->deflater;
+    struct outqueue_t *q = &sub->queue;
+    ssize_t status;
+
+    if (dp->sent == dp->len) {
+	size_t in = 0;
+
+	dp->sent = dp->len = 0;
+	/* whole messages only, as many as are sure to fit */
+	while (0 < q->count && q->msg[q->first].deflate) {
+	    struct outmsg_t *mp = &q->msg[q->first];
+
+	    if (DEFLATE_BOUND(in + mp->len) > dp->size) {
+		unsigned char *grown;
+
+		if (0 < in)
+		    break;
+		grown = realloc(dp->out, DEFLATE_BOUND(mp->len));
+		if (NULL == grown)
+		    return -1;
+		dp->out = grown;
+		dp->size = DEFLATE_BOUND(mp->len);
+	    }
+	    if (0 == in) {
+		dp->z.next_out = dp->out;
+		dp->z.avail_out = (uInt)dp->size;
+	    }
+	    dp->z.next_in = (Bytef *)mp->data;
+	    dp->z.avail_in = (uInt)mp->len;
+	    (void)deflate(&dp->z, Z_NO_FLUSH);
+	    in += mp->len;
+	    q->bytes -= mp->len;
+	    outmsg_free(mp);
+	    q->first = (q->first + 1) % q->slots;
+	    q->count--;
+	}
+	if (0 == in)
+	    return 1;
+	(void)deflate(&dp->z, Z_SYNC_FLUSH);
+	dp->len = dp->size - dp->z.avail_out;
+    }
+    status = write(sub->fd, dp->out + dp->sent, dp->len - dp->sent);
+    if (status < 0) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+	    return 0;
+	return -1;
+    }
+    q->progress = time(NULL);
+    dp->sent += (size_t)status;
+    return (dp->sent == dp->len) ? 1 : 0;
+}
+#endif /* ZLIB_ENABLE */
+
+static int queue_flush(struct subscriber_t *sub)
+/* write out as much queued output as the socket will take, several
+ * messages per writev(); caller holds sub's lock.  -1 on write error */
+{
+    struct outqueue_t *q = &sub->queue;
+    bool more;
+
+    q->fresh = 0;
+    for (;;) {
+	struct iovec iov[FLUSH_IOV];
+	unsigned int i, n = q->count < FLUSH_IOV ? q->count : FLUSH_IOV;
+	size_t left, total = 0;
+	ssize_t status;
+
+#ifdef ZLIB_ENABLE
+	/* plain messages only ever precede compressed ones */
+	if (deflate_pending(sub)) {
+	    int zstatus = deflate_flush(sub);
+
+	    if (zstatus < 0)
+		return -1;
+	    if (0 == zstatus)
+		break;		/* the socket is full */
+	    continue;
+	}
+#endif /* ZLIB_ENABLE */
+	if (0 == q->count)
+	    break;
+	/* on a framed socket each write is one message to the client */
+	if (sub->framed)
+	    n = 1;
+	for (i = 0; i < n; i++) {
+	    struct outmsg_t *mp = &q->msg[(q->first + i) % q->slots];
+
+#ifdef ZLIB_ENABLE
+	    if (mp->deflate) {
+		n = i;
+		break;
+	    }
+#endif /* ZLIB_ENABLE */
+	    iov[i].iov_base = mp->data + mp->sent;
+	    iov[i].iov_len = mp->len - mp->sent;
+	    total += iov[i].iov_len;
+	}
+	status = writev(sub->fd, iov, (int)n);
+	if (status < 0) {
+	    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		break;
+	    return -1;
+	}
+	q->progress = time(NULL);
+	q->bytes -= (size_t)status;
+	/* retire the messages that went out whole */
+	for (left = (size_t)status; 0 < left; ) {
+	    struct outmsg_t *mp = &q->msg[q->first];
+
+	    if (left < mp->len - mp->sent) {
+		mp->sent += left;
+		break;
+	    }
+	    left -= mp->len - mp->sent;
+	    outmsg_free(mp);
+	    q->first = (q->first + 1) % q->slots;
+	    q->count--;
+	}
+	if ((size_t)status < total)
+	    break;		/* the socket is full */
+    }
+    more = q->count > 0;
+#ifdef ZLIB_ENABLE
+    more = more || deflate_pending(sub);
+#endif /* ZLIB_ENABLE */
+    /* have the event loop tell us when there's room for the rest */
+    (void)gpsd_evloop_modify(&evloop, sub->fd,
+			     EVLOOP_READ | (more ? EVLOOP_WRITE : 0));
+    return 0;
 }
 
 static void detach_client(struct subscriber_t *sub)
 /* detach a client and terminate the session */
 {
     char *c_ip;
+    lock_clients();
     lock_subscriber(sub);
     if (sub->fd == UNALLOCATED_FD) {
 	unlock_subscriber(sub);
+	unlock_clients();
 	return;
     }
     c_ip = netlib_sock2ip(sub->fd);
+    gpsd_evloop_remove(&evloop, sub->fd);
     (void)shutdown(sub->fd, SHUT_RDWR);
     GPSD_LOG(LOG_SPIN, &context.errout,
 	     "close(%d) in detach_client()\n",
@@ -553,8 +1284,23 @@ static void detach_client(struct subscriber_t *sub)
     GPSD_LOG(LOG_INF, &context.errout,
 	     "detaching %s (sub %d, fd %d) in detach_client\n",
 	     c_ip, sub_index(sub), sub->fd);
-    FD_CLR(sub->fd, &all_fds);
-    adjust_max_fd(sub->fd, false);
+    if (0 < sub->queue.maxbytes)
+	GPSD_LOG(LOG_INF, &context.errout,
+		 "client(%d) queue: %u msgs %zu bytes pending, "
+		 "max %zu bytes, %lu dropped, %lu coalesced\n",
+		 sub_index(sub), sub->queue.count, sub->queue.bytes,
+		 sub->queue.maxbytes, sub->queue.dropped,
+		 sub->queue.coalesced);
+    queue_clear(&sub->queue);
+    sub->batched = false;
+    sub->framed = false;
+    sub->delta_whole = 0;
+    memset(sub->due, 0, sizeof(sub->due));
+    free(sub->aisdue);
+    sub->aisdue = NULL;
+#ifdef ZLIB_ENABLE
+    deflate_end(sub);
+#endif /* ZLIB_ENABLE */
     sub->active = 0;
     sub->policy.watcher = false;
     sub->policy.json = false;
@@ -563,16 +1309,26 @@ static void detach_client(struct subscriber_t *sub)
     sub->policy.scaled = false;
     sub->policy.timing = false;
     sub->policy.split24 = false;
+    sub->policy.binary = false;
+    sub->policy.delta = false;
+    sub->policy.fields[0] = '\0';
+    sub->policy.interval = 0;
+    sub->policy.aisinterval = 0;
+    sub->policy.compress = false;
     sub->policy.devpath[0] = '\0';
     sub->fd = UNALLOCATED_FD;
     unlock_subscriber(sub);
+    watch_remove(sub);
+    release_client(sub);
+    unlock_clients();
 }
 
-static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
-			       size_t len)
-/* write to client -- throttle if it's gone or we're close to buffer overrun */
+static ssize_t shared_write(struct subscriber_t *sub, char *buf,
+			    size_t len, struct shared_t *shared)
+/* write to client -- queue whatever the socket won't take right now.
+ * If shared is not NULL buf is its data, and the queue refers to it */
 {
-    ssize_t status;
+    ssize_t status = 0;
 
     if (context.errout.debug >= LOG_CLIENT) {
 	if (isprint((unsigned char) buf[0]))
@@ -591,33 +1347,95 @@ static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
 	}
     }
 
-    gpsd_acquire_reporting_lock();
-    status = send(sub->fd, buf, len, 0);
-    gpsd_release_reporting_lock();
-
-    if (status == (ssize_t) len)
-	return status;
-    else if (status > -1) {
-	GPSD_LOG(LOG_INF, &context.errout,
-		 "short write disconnecting client(%d)\n",
-		 sub_index(sub));
-	detach_client(sub);
-	return 0;
-    } else if (errno == EAGAIN || errno == EINTR)
-	return 0;		/* no data written, and errno says to retry */
-    else if (errno == EBADF)
-	GPSD_LOG(LOG_WARN, &context.errout,
-		 "client(%d) has vanished.\n", sub_index(sub));
-    else if (errno == EWOULDBLOCK
-	     && time(NULL) - sub->active > NOREAD_TIMEOUT)
-	GPSD_LOG(LOG_INF, &context.errout,
-		 "client(%d) timed out.\n", sub_index(sub));
+    lock_subscriber(sub);
+    if (NULL != shared)
+	queue_push(sub, buf, len, 0, shared);
     else
+	queue_output(sub, buf, len, 0);
+    /* on the main thread, hold it for flush_batched(), unless the
+     * batch has grown big enough to go now */
+    if (pthread_equal(pthread_self(), main_thread)
+	&& FLUSH_IOV > sub->queue.fresh
+	&& queue_limit / 2 > sub->queue.bytes) {
+	if (sub->batched) {
+	    unlock_subscriber(sub);
+	    return (ssize_t)len;
+	}
+	if (nbatched == maxbatched) {
+	    struct subscriber_t **grown;
+
+	    grown = realloc(batched,
+			    (maxbatched + CLIENTS_CHUNK) * sizeof(*batched));
+	    if (NULL != grown) {
+		batched = grown;
+		maxbatched += CLIENTS_CHUNK;
+	    }
+	}
+	if (nbatched < maxbatched) {
+	    sub->batched = true;
+	    batched[nbatched++] = sub;
+	    unlock_subscriber(sub);
+	    return (ssize_t)len;
+	}
+    }
+    status = queue_flush(sub);
+    unlock_subscriber(sub);
+    if (status < 0) {
+	if (errno == EBADF)
+	    GPSD_LOG(LOG_WARN, &context.errout,
+		     "client(%d) has vanished.\n", sub_index(sub));
+	else
+	    GPSD_LOG(LOG_INF, &context.errout,
+		     "client(%d) write: %s\n",
+		     sub_index(sub), strerror(errno));
+	detach_client(sub);
+	return -1;
+    }
+    return (ssize_t)len;
+}
+
+static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
+			       size_t len)
+/* write to client -- a private copy of whatever has to wait */
+{
+    return shared_write(sub, buf, len, NULL);
+}
+
+static void flush_client(struct subscriber_t *sub)
+/* the client's socket is writable: send as much queued output as it takes */
+{
+    int status;
+
+    lock_subscriber(sub);
+    status = queue_flush(sub);
+    unlock_subscriber(sub);
+    if (status < 0) {
 	GPSD_LOG(LOG_INF, &context.errout,
 		 "client(%d) write: %s\n",
 		 sub_index(sub), strerror(errno));
-    detach_client(sub);
-    return status;
+	detach_client(sub);
+    }
+}
+
+static void flush_batched(void)
+/* send each client everything gathered for it in this main-loop pass */
+{
+    int i;
+
+    for (i = 0; i < nbatched; i++) {
+	struct subscriber_t *sub = batched[i];
+
+	lock_subscriber(sub);
+	/* skip clients detached, or flushed and reused, since batching */
+	if (!sub->batched || sub->fd == UNALLOCATED_FD) {
+	    unlock_subscriber(sub);
+	    continue;
+	}
+	sub->batched = false;
+	unlock_subscriber(sub);
+	flush_client(sub);
+    }
+    nbatched = 0;
 }
 
 static void notify_watchers(struct gps_device_t *device,
@@ -628,16 +1446,25 @@ static void notify_watchers(struct gps_device_t *device,
     va_list ap;
     char buf[BUFSIZ];
     struct subscriber_t *sub;
+    int i, list;
 
     va_start(ap, sentence);
     (void)vsnprintf(buf, sizeof(buf), sentence, ap);
     va_end(ap);
 
-    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++)
-	if (sub->active != 0 && subscribed(sub, device)) {
+    lock_clients();
+    for (list = 0; list < 2; list++) {
+	struct watchlist_t *wl =
+	    &watchers[list ? WATCH_ALL : (int)(device - devices)];
+
+	/* backwards, as a failed write detaches the client */
+	for (i = wl->count - 1; i >= 0; i--) {
+	    sub = wl->subs[i];
 	    if ((onjson && sub->policy.json) || (onpps && sub->policy.pps))
 		(void)throttled_write(sub, buf, strlen(buf));
 	}
+    }
+    unlock_clients();
 }
 #endif /* SOCKET_EXPORT_ENABLE */
 
@@ -650,11 +1477,13 @@ static void deactivate_device(struct gps_device_t *device)
 		    device->gpsdata.dev.path);
 #endif /* SOCKET_EXPORT_ENABLE */
     if (!BAD_SOCKET(device->gpsdata.gps_fd)) {
-	FD_CLR(device->gpsdata.gps_fd, &all_fds);
-	adjust_max_fd(device->gpsdata.gps_fd, false);
+	device_watch(device, false);
 	ntpshm_link_deactivate(device);
 	gpsd_deactivate(device);
     }
+#ifdef SHM_EXPORT_ENABLE
+    shm_device_release(&context, device);
+#endif /* SHM_EXPORT_ENABLE */
 }
 
 /* find the device block for an existing device name */
@@ -671,6 +1500,44 @@ static struct gps_device_t *find_device(const char *device_name)
     return NULL;
 }
 
+#ifdef SOCKET_EXPORT_ENABLE
+static void watch_index(struct subscriber_t *sub)
+/* file a client under the device(s) its policy says it watches */
+{
+    struct gps_device_t *devp;
+
+    lock_clients();
+    if (!sub->policy.watcher)
+	watch_remove(sub);
+    else if ('\0' == sub->policy.devpath[0])
+	watch_add(sub, WATCH_ALL);
+    else if (NULL != (devp = find_device(sub->policy.devpath)))
+	watch_add(sub, (int)(devp - devices));
+    else
+	watch_remove(sub);
+    unlock_clients();
+}
+
+static void watch_index_device(struct gps_device_t *devp)
+/* a device has taken over its slot: rebuild that slot's watcher list */
+{
+    struct watchlist_t *wl = &watchers[devp - devices];
+    int i;
+
+    lock_clients();
+    while (0 < wl->count)
+	watch_remove(wl->subs[0]);
+    for (i = 0; i < nclients; i++) {
+	struct subscriber_t *sub = clients[i];
+
+	if (sub->policy.watcher && '\0' != sub->policy.devpath[0]
+	    && 0 == strcmp(sub->policy.devpath, devp->gpsdata.dev.path))
+	    watch_add(sub, (int)(devp - devices));
+    }
+    unlock_clients();
+}
+#endif /* SOCKET_EXPORT_ENABLE */
+
 static bool open_device( struct gps_device_t *device)
 /* open the input device
  * return: false on failure
@@ -705,8 +1572,7 @@ static bool open_device( struct gps_device_t *device)
 	/* it is a /dev/ppsX, no need to wait on it */
         return true;
     }
-    FD_SET(device->gpsdata.gps_fd, &all_fds);
-    adjust_max_fd(device->gpsdata.gps_fd, true);
+    device_watch(device, true);
     ++highwater;
     return true;
 }
@@ -735,6 +1601,9 @@ bool gpsd_add_device(const char *device_name, bool flag_nowait)
 	if (!allocated_device(devp)) {
 	    gpsd_init(devp, &context, device_name);
 	    ntpshm_session_init(devp);
+#ifdef SOCKET_EXPORT_ENABLE
+	    watch_index_device(devp);
+#endif /* SOCKET_EXPORT_ENABLE */
 	    GPSD_LOG(LOG_INF, &context.errout,
 		     "stashing device %s at slot %d\n",
 		     device_name, (int)(devp - devices));
@@ -921,6 +1790,31 @@ static void handle_control(int sfd, char *buf)
 	    ignore_return(write(sfd, "\n", 1));
 	}
 	ignore_return(write(sfd, "OK\n", 3));
+#ifdef SOCKET_EXPORT_ENABLE
+    } else if (strstr(buf, "?clients")==buf) {
+	/* write back output queue statistics, one client a line, then OK */
+	int i;
+
+	lock_clients();
+	for (i = 0; i < nclients; i++) {
+	    struct subscriber_t *sub = clients[i];
+	    char line[BUFSIZ];
+
+	    if (sub->active == 0)
+		continue;
+	    lock_subscriber(sub);
+	    (void)snprintf(line, sizeof(line),
+			   "%d %s %u %zu %zu %lu %lu\n",
+			   sub_index(sub), netlib_sock2ip(sub->fd),
+			   sub->queue.count, sub->queue.bytes,
+			   sub->queue.maxbytes, sub->queue.dropped,
+			   sub->queue.coalesced);
+	    unlock_subscriber(sub);
+	    ignore_return(write(sfd, line, strlen(line)));
+	}
+	unlock_clients();
+	ignore_return(write(sfd, "OK\n", 3));
+#endif /* SOCKET_EXPORT_ENABLE */
     } else {
 	/* unknown command */
 	ignore_return(write(sfd, "ERROR\n", 6));
@@ -964,8 +1858,7 @@ static bool awaken(struct gps_device_t *device)
 	    GPSD_LOG(LOG_RAW, &context.errout,
                      "flagging descriptor %d in assign_channel()\n",
                      device->gpsdata.gps_fd);
-	    FD_SET(device->gpsdata.gps_fd, &all_fds);
-	    adjust_max_fd(device->gpsdata.gps_fd, true);
+	    device_watch(device, true);
 	    return true;
 	}
     }
@@ -977,10 +1870,9 @@ static bool privileged_user(struct gps_device_t *device)
 /* is this channel privileged to change a device's behavior? */
 {
     /* grant user privilege if he's the only one listening to the device */
-    struct subscriber_t *sub;
-    int subcount = 0;
-    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
-	if (subscribed(sub, device))
+    int i, subcount = 0;
+    for (i = 0; i < nclients; i++) {
+	if (subscribed(clients[i], device))
 	    subcount++;
     }
     /*
@@ -1055,40 +1947,304 @@ static void set_serial(struct gps_device_t *device,
     }
     /* *INDENT-ON* */
 }
-#endif /* RECONFIGURE_ENABLE */
+#endif /* RECONFIGURE_ENABLE */
+
+#ifdef SOCKET_EXPORT_ENABLE
+static void json_devicelist_dump(char *reply, size_t replylen)
+{
+    struct gps_device_t *devp;
+    (void)strlcpy(reply, "{\"class\":\"DEVICES\",\"devices\":[", replylen);
+    for (devp = devices; devp < devices + MAX_DEVICES; devp++)
+	if (allocated_device(devp)
+	    && strlen(reply) + strlen(devp->gpsdata.dev.path) + 3 <
+	    replylen - 1) {
+	    char *cp;
+	    json_device_dump(devp,
+			     reply + strlen(reply), replylen - strlen(reply));
+	    cp = reply + strlen(reply);
+	    *--cp = '\0';
+	    *--cp = '\0';
+	    (void)strlcat(reply, ",", replylen);
+	}
+
+    str_rstrip_char(reply, ',');
+    (void)strlcat(reply, "]}\r\n", replylen);
+}
+#endif /* SOCKET_EXPORT_ENABLE */
+
+static void rstrip(char *str)
+/* strip trailing \r\n\t\SP from a string */
+{
+    char *strend;
+    strend = str + strlen(str) - 1;
+    while (isspace((unsigned char) *strend)) {
+	*strend = '\0';
+	--strend;
+    }
+}
+
+/*
+ * Delta reports.  Watchers that asked for "delta":true get TPV and SKY
+ * cut down to what changed since the device's previous report of that
+ * class, see json_delta(), with the whole report every DELTA_KEYFRAME
+ * and whenever a delta can't express the change.  The base is the
+ * previous report's text, so changes below JSON's precision don't count.
+ * Plain and scaled watchers get differently rendered reports, so each
+ * of those variants has bases of its own.  A client that lost a delta
+ * from its queue gets whole reports until it has had one of each class.
+ */
+#define DELTA_KEYFRAME	10
+#define DELTA_CLASSES	2
+#define DELTA_VARIANTS	2	/* plain and scaled */
+
+static const char *const delta_classes[DELTA_CLASSES] = {
+    "{\"class\":\"TPV\",", "{\"class\":\"SKY\",",
+};
+
+static struct delta_base_t {
+    char text[GPS_JSON_RESPONSE_MAX];
+    unsigned int count;		/* reports since the base was cleared */
+} delta_base[MAX_DEVICES][DELTA_VARIANTS][DELTA_CLASSES];
+
+static int delta_class(const char *line)
+/* which delta_base a report line belongs to, -1 if none */
+{
+    int c;
+
+    for (c = 0; c < DELTA_CLASSES; c++)
+	if (str_starts_with(line, delta_classes[c]))
+	    return c;
+    return -1;
+}
+
+static unsigned int delta_classes_in(const char *full, size_t len)
+/* which delta classes, as a bit mask, a report encoding holds whole */
+{
+    unsigned int mask = 0;
+
+    while (0 < len) {
+	const char *nl = memchr(full, '\n', len);
+	size_t n = (NULL == nl) ? len : (size_t)(nl - full) + 1;
+	int c = delta_class(full);
+
+	if (0 <= c)
+	    mask |= 1u << c;
+	full += n;
+	len -= n;
+    }
+    return mask;
+}
+
+static void delta_restart(const struct gps_device_t *device)
+/* make a device's next TPV and SKY whole, for a new delta watcher */
+{
+    struct delta_base_t *dp = delta_base[device - devices][0];
+    int i;
+
+    for (i = 0; i < DELTA_VARIANTS * DELTA_CLASSES; i++)
+	dp[i].count = 0;
+}
+
+static size_t delta_report(const struct gps_device_t *device, int v,
+			   const char *full, size_t len,
+			   char *out, size_t outlen)
+/* copy report encoding variant v with its TPV and SKY lines as deltas */
+{
+    struct delta_base_t *base = delta_base[device - devices][v];
+    char line[GPS_JSON_RESPONSE_MAX];
+    size_t used = 0;
+
+    while (0 < len) {
+	const char *nl = memchr(full, '\n', len);
+	size_t n = (NULL == nl) ? len : (size_t)(nl - full) + 1;
+	int c = delta_class(full);
+
+	if (0 <= c && 0 != base[c].count % DELTA_KEYFRAME
+	    && 2 < n && n - 2 < sizeof(line) && '\r' == full[n - 2]) {
+	    memcpy(line, full, n - 2);
+	    line[n - 2] = '\0';
+	    if (json_delta(base[c].text, line, out + used, outlen - used - 2)) {
+		used += strlen(out + used);
+		memcpy(out + used, "\r\n", 3);
+		used += 2;
+		full += n;
+		len -= n;
+		continue;
+	    }
+	}
+	/* the whole line, then */
+	if (used + n >= outlen)
+	    break;
+	memcpy(out + used, full, n);
+	used += n;
+	out[used] = '\0';
+	full += n;
+	len -= n;
+    }
+    return used;
+}
+
+static void delta_update(const struct gps_device_t *device, int v,
+			 const char *full, size_t len)
+/* take this report's TPV and SKY as variant v's next delta bases */
+{
+    struct delta_base_t *base = delta_base[device - devices][v];
+
+    while (0 < len) {
+	const char *nl = memchr(full, '\n', len);
+	size_t n = (NULL == nl) ? len : (size_t)(nl - full) + 1;
+	int c = delta_class(full);
+
+	if (0 <= c) {
+	    if (2 < n && n - 2 < sizeof(base[c].text)) {
+		memcpy(base[c].text, full, n - 2);
+		base[c].text[n - 2] = '\0';
+	    } else
+		base[c].text[0] = '\0';
+	    base[c].count++;
+	}
+	full += n;
+	len -= n;
+    }
+}
+
+/*
+ * Projections.  A watcher that named "fields" in ?WATCH gets each JSON
+ * report cut down to those members, see json_project(), and none at all
+ * of a report that has none of them.  Watchers naming the same fields
+ * share one cut of a report, so a few distinct projections are kept
+ * per report, the oldest giving way past that.
+ */
+#define PROJECTIONS	4
+
+static size_t project_report(const char *fields,
+			     const char *full, size_t len,
+			     char *out, size_t outlen)
+/* copy a report encoding with its JSON objects cut down to fields */
+{
+    char line[GPS_JSON_RESPONSE_MAX];
+    size_t used = 0;
+
+    out[0] = '\0';
+    while (0 < len) {
+	const char *nl = memchr(full, '\n', len);
+	size_t n = (NULL == nl) ? len : (size_t)(nl - full) + 1;
+
+	if (BINARY_MAGIC == (unsigned char)full[0]) {
+	    /* binary records go as they are */
+	    ssize_t reclen = binary_record_length(full, len);
+
+	    n = (0 < reclen && (size_t)reclen <= len) ? (size_t)reclen : len;
+	} else if ('{' == full[0] && 2 < n && n - 2 < sizeof(line)
+		   && '\r' == full[n - 2]) {
+	    memcpy(line, full, n - 2);
+	    line[n - 2] = '\0';
+	    if (json_project(fields, line, out + used, outlen - used - 2)) {
+		used += strlen(out + used);
+		memcpy(out + used, "\r\n", 3);
+		used += 2;
+	    } else
+		out[used] = '\0';	/* nothing wanted in this one */
+	    full += n;
+	    len -= n;
+	    continue;
+	}
+	if (used + n >= outlen)
+	    break;
+	memcpy(out + used, full, n);
+	used += n;
+	out[used] = '\0';
+	full += n;
+	len -= n;
+    }
+    return used;
+}
+
+/*
+ * Decimation.  A watcher that set "interval" gets at most one report of
+ * each superseding class per device in that many seconds, the first one
+ * due, which is the newest there is at that moment.  With "aisinterval"
+ * the same goes for AIS reports per ship, tracked in a small table that
+ * forgets a ship when another hashes onto its slot, so the worst that
+ * happens is an extra report.  A deadline moves on by whole intervals,
+ * so jitter in the device's own cadence doesn't stretch the client's.
+ */
+#define AIS_SLOTS	256
+
+static bool held_back(double *due, double interval, double now)
+/* is a report not yet due?  If it is, set the next deadline */
+{
+    if (now < *due)
+	return true;
+    *due += interval;
+    if (*due <= now)		/* the first report, or after a gap */
+	*due = now + interval;
+    return false;
+}
 
-#ifdef SOCKET_EXPORT_ENABLE
-static void json_devicelist_dump(char *reply, size_t replylen)
+static bool decimated(struct subscriber_t *sub,
+		      const struct gps_device_t *device,
+		      const char *buf, size_t len, double now)
+/* should this report be held back from the subscriber? */
 {
-    struct gps_device_t *devp;
-    (void)strlcpy(reply, "{\"class\":\"DEVICES\",\"devices\":[", replylen);
-    for (devp = devices; devp < devices + MAX_DEVICES; devp++)
-	if (allocated_device(devp)
-	    && strlen(reply) + strlen(devp->gpsdata.dev.path) + 3 <
-	    replylen - 1) {
-	    char *cp;
-	    json_device_dump(devp,
-			     reply + strlen(reply), replylen - strlen(reply));
-	    cp = reply + strlen(reply);
-	    *--cp = '\0';
-	    *--cp = '\0';
-	    (void)strlcat(reply, ",", replylen);
-	}
+    int c = -1;
 
-    str_rstrip_char(reply, ',');
-    (void)strlcat(reply, "]}\r\n", replylen);
+    if (BINARY_MAGIC == (unsigned char)buf[0] && 2 <= len)
+	c = (BINARY_TPV == buf[1]) ? 0 : (BINARY_SKY == buf[1]) ? 1 : -1;
+    else if (str_starts_with(buf, "{\"class\":\""))
+	for (c = SUPERSEDING - 1; 0 <= c; c--)
+	    if (0 == strncmp(buf + 10, superseding[c], 3) && '"' == buf[13])
+		break;
+
+    if (0 <= c && 0 < sub->policy.interval)
+	return held_back(&sub->due[device - devices][c],
+			 sub->policy.interval, now);
+    if (0 < sub->policy.aisinterval
+	&& str_starts_with(buf, "{\"class\":\"AIS\",")) {
+	const char *cp = strstr(buf, "\"mmsi\":");
+	struct ais_due_t *ap;
+	unsigned int mmsi;
+
+	if (NULL == cp || cp >= buf + len)
+	    return false;
+	mmsi = (unsigned int)strtoul(cp + 7, NULL, 10);
+	if (NULL == sub->aisdue
+	    && NULL == (sub->aisdue = calloc(AIS_SLOTS, sizeof(*ap))))
+	    return false;
+	ap = &sub->aisdue[mmsi % AIS_SLOTS];
+	if (ap->mmsi != mmsi) {
+	    ap->mmsi = mmsi;
+	    ap->due = 0;
+	}
+	return held_back(&ap->due, sub->policy.aisinterval, now);
+    }
+    return false;
 }
-#endif /* SOCKET_EXPORT_ENABLE */
 
-static void rstrip(char *str)
-/* strip trailing \r\n\t\SP from a string */
+static void decimated_write(struct subscriber_t *sub,
+			    const struct gps_device_t *device,
+			    char *buf, size_t len)
+/* write the reports in buf that the subscriber's intervals let through */
 {
-    char *strend;
-    strend = str + strlen(str) - 1;
-    while (isspace((unsigned char) *strend)) {
-	*strend = '\0';
-	--strend;
+    struct timespec ts;
+    char *run = buf;		/* start of the reports let through */
+    double now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = TSTONS(&ts);
+    while (0 < len) {
+	size_t n = report_length(buf, len);
+
+	if (decimated(sub, device, buf, n, now)) {
+	    if (run < buf && 0 > throttled_write(sub, run, (size_t)(buf - run)))
+		return;
+	    run = buf + n;
+	}
+	buf += n;
+	len -= n;
     }
+    if (run < buf)
+	(void)throttled_write(sub, run, (size_t)(buf - run));
 }
 
 static void handle_request(struct subscriber_t *sub,
@@ -1109,7 +2265,24 @@ static void handle_request(struct subscriber_t *sub,
 	    ++buf;
 	} else {
 	    int status = json_watch_read(buf + 1, &sub->policy, &end);
+	    /* verbatim packets may start with BINARY_MAGIC (UBX does),
+	     * so binary records and raw 2 can't share a stream */
+	    bool clash = sub->policy.binary && 2 <= sub->policy.raw;
+
+	    if (clash)
+		sub->policy.binary = false;
 	    sub->policy.timing = false;
+	    /* once the stream is deflated there's no going back; and
+	     * a local framed client has nothing to gain from it */
+#ifdef ZLIB_ENABLE
+	    if (NULL != sub->deflater)
+		sub->policy.compress = true;
+	    else if (sub->framed)
+		sub->policy.compress = false;
+#else
+	    sub->policy.compress = false;
+#endif /* ZLIB_ENABLE */
+	    watch_index(sub);
 	    if (end == NULL)
 		buf += strlen(buf);
 	    else {
@@ -1123,6 +2296,12 @@ static void handle_request(struct subscriber_t *sub,
                                "\"Invalid WATCH: %s\"}\r\n",
 			       json_error_string(status));
 		GPSD_LOG(LOG_ERROR, &context.errout, "response: %s\n", reply);
+	    } else if (clash) {
+		(void)strlcpy(reply,
+			      "{\"class\":\"ERROR\",\"message\":"
+			      "\"Invalid WATCH: binary with raw 2\"}\r\n",
+			      replylen);
+		GPSD_LOG(LOG_ERROR, &context.errout, "response: %s\n", reply);
 	    } else if (sub->policy.watcher) {
 		if (sub->policy.devpath[0] == '\0') {
 		    /* awaken all devices */
@@ -1146,6 +2325,10 @@ static void handle_request(struct subscriber_t *sub,
 				 "response: %s\n", reply);
 			goto bailout;
 		    } else if (awaken(devp)) {
+			/* a new delta watcher needs whole reports to
+			 * start from; others only ever get whole ones */
+			if (sub->policy.delta)
+			    delta_restart(devp);
 			if (devp->sourcetype == source_gpsd) {
 			    (void)gpsd_write(devp, start, (size_t)(end-start));
 			}
@@ -1378,46 +2561,49 @@ static void handle_request(struct subscriber_t *sub,
     *after = buf;
 }
 
-static void raw_report(struct subscriber_t *sub, struct gps_device_t *device)
-/* report a raw packet to a subscriber */
+static void raw_report(struct subscriber_t *sub, struct gps_device_t *device,
+		       struct shared_t **verbatim, struct shared_t **hex)
+/* report a raw packet to a subscriber; the renderings are made on first
+ * use and kept in *verbatim and *hex for the other subscribers */
 {
+    struct shared_t **rendered = NULL;
+
     /* *INDENT-OFF* */
     /*
      * NMEA and other textual sentences are simply
      * copied to all clients that are in raw or nmea
-     * mode.
-     */
-    if (TEXTUAL_PACKET_TYPE(device->lexer.type)
-	&& (sub->policy.raw > 0 || sub->policy.nmea)) {
-	(void)throttled_write(sub,
-			      (char *)device->lexer.outbuffer,
-			      device->lexer.outbuflen);
-	return;
-    }
-
-    /*
-     * Also, simply copy if user has specified
+     * mode.  Also, simply copy if user has specified
      * super-raw mode.
      */
-    if (sub->policy.raw > 1) {
-	(void)throttled_write(sub,
-			      (char *)device->lexer.outbuffer,
-			      device->lexer.outbuflen);
-	return;
+    if ((TEXTUAL_PACKET_TYPE(device->lexer.type)
+	 && (sub->policy.raw > 0 || sub->policy.nmea))
+	|| sub->policy.raw > 1) {
+	if (NULL == *verbatim)
+	    *verbatim = shared_new((char *)device->lexer.outbuffer,
+				   device->lexer.outbuflen);
+	rendered = verbatim;
     }
 #ifdef BINARY_ENABLE
     /*
      * Maybe the user wants a binary packet hexdumped.
      */
-    if (sub->policy.raw == 1) {
-	const char *hd =
-	    gpsd_hexdump(device->msgbuf, sizeof(device->msgbuf),
-			 (char *)device->lexer.outbuffer,
-			 device->lexer.outbuflen);
-	(void)strlcat((char *)hd, "\r\n", sizeof(device->msgbuf));
-	(void)throttled_write(sub, (char *)hd, strlen(hd));
+    else if (sub->policy.raw == 1) {
+	if (NULL == *hex) {
+	    const char *hd =
+		gpsd_hexdump(device->msgbuf, sizeof(device->msgbuf),
+			     (char *)device->lexer.outbuffer,
+			     device->lexer.outbuflen);
+	    (void)strlcat((char *)hd, "\r\n", sizeof(device->msgbuf));
+	    *hex = shared_new(hd, strlen(hd));
+	}
+	rendered = hex;
     }
+#else
+    (void)hex;
 #endif /* BINARY_ENABLE */
+    if (NULL != rendered && NULL != *rendered)
+	(void)shared_write(sub, (*rendered)->data, (*rendered)->len,
+			   *rendered);
 }
 
 static void pseudonmea_report(struct subscriber_t *sub,
@@ -1465,21 +2651,74 @@ static void pseudonmea_report(struct subscriber_t *sub,
 }
 #endif /* SOCKET_EXPORT_ENABLE */
 
+#ifdef SOCKET_EXPORT_ENABLE
+/*
+ * json_data_report() output depends only on these policy bits, so
+ * subscribers that agree on them can share one encoding of a report.
+ */
+#define JSON_VARIANT_SCALED	0x01
+#define JSON_VARIANT_TIMING	0x02
+#define JSON_VARIANT_BINARY	0x04
+#define JSON_VARIANT_DELTA	0x08
+#define JSON_VARIANTS		16
+
+static unsigned int json_variant(const struct gps_policy_t *policy)
+/* which cached encoding this policy's JSON reports come from */
+{
+    unsigned int variant = 0;
+
+    if (policy->scaled)
+	variant |= JSON_VARIANT_SCALED;
+    if (policy->timing)
+	variant |= JSON_VARIANT_TIMING;
+    if (policy->binary)
+	variant |= JSON_VARIANT_BINARY;
+    /*
+     * binary TPV and SKY are already small, timing ones never repeat,
+     * a delta that decimation drops would be lost to the client, and
+     * a client merges deltas from all the devices it watches into one
+     * copy, so it must watch only one
+     */
+    else if (policy->delta && !policy->timing && 0 >= policy->interval
+	     && '\0' != policy->devpath[0])
+	variant |= JSON_VARIANT_DELTA;
+    return variant;
+}
+
+#endif /* SOCKET_EXPORT_ENABLE */
+
 static void all_reports(struct gps_device_t *device, gps_mask_t changed)
 /* report on the current packet from a specified device */
 {
 #ifdef SOCKET_EXPORT_ENABLE
     struct subscriber_t *sub;
+    /* per-cycle JSON encodings, built on first use by a watcher */
+    static struct {
+	char buf[GPS_JSON_RESPONSE_MAX * 4];
+	size_t len;
+    } json_cache[JSON_VARIANTS];
+    bool json_cached[JSON_VARIANTS] = {false};
+    /* and cuts of them for watchers that named their fields */
+    static struct {
+	unsigned int variant;
+	char fields[GPS_FIELDS_MAX];
+	char buf[GPS_JSON_RESPONSE_MAX * 4];
+	size_t len;
+    } proj_cache[PROJECTIONS];
+    unsigned int nproj = 0;
+    /* whole encodings delta watchers got, to take new bases from */
+    bool delta_from[DELTA_VARIANTS] = {false};
+    /* the packet as raw subscribers get it, made on first use */
+    struct shared_t *rawcopy = NULL, *rawhex = NULL;
+    int i, list;
 
     /* add any just-identified device to watcher lists */
     if ((changed & DRIVER_IS) != 0) {
-	bool listeners = false;
-	for (sub = subscribers;
-	     sub < subscribers + MAX_CLIENTS; sub++)
-	    if (sub->active != 0
-		&& sub->policy.watcher
-		&& subscribed(sub, device))
-		listeners = true;
+	bool listeners;
+	lock_clients();
+	listeners = 0 < watchers[device - devices].count
+		    || 0 < watchers[WATCH_ALL].count;
+	unlock_clients();
 	if (listeners) {
 	    (void)awaken(device);
 	}
@@ -1631,63 +2870,178 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
     if ((changed & (REPORT_IS|GST_SET|SATELLITE_SET|SUBFRAME_SET|
 		    ATTITUDE_SET|RTCM2_SET|RTCM3_SET|AIS_SET)) != 0)
 	shm_update(&context, &device->gpsdata);
+    if ((changed & (REPORT_IS|SATELLITE_SET|RAW_SET)) != 0)
+	shm_device_update(&context, device, (int)(device - devices),
+			  changed);
 #endif /* SHM_EXPORT_ENABLE */
 
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+    /* the UDP export carries what a plain JSON watcher would get */
+    if (0 <= context.udpfd && (changed & DATA_IS) != 0
+	&& (changed & PASSTHROUGH_IS) == 0
+	&& !((changed & AIS_SET) != 0 && device->gpsdata.ais.type == 24
+	     && device->gpsdata.ais.type24.part != both)) {
+	static const struct gps_policy_t udp_policy = {
+	    .watcher = true, .json = true};
+
+	if (!json_cached[0]) {
+	    json_data_report(changed, device, &udp_policy,
+			     json_cache[0].buf, sizeof(json_cache[0].buf));
+	    json_cache[0].len = strlen(json_cache[0].buf);
+	    json_cached[0] = true;
+	}
+	udp_update(&context, device, json_cache[0].buf, json_cache[0].len);
+    }
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
+
 #ifdef SOCKET_EXPORT_ENABLE
     /* update all subscribers associated with this device */
-    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
-	if (sub == NULL || sub->active == 0 || !subscribed(sub, device))
-	    continue;
+    lock_clients();
+    for (list = 0; list < 2; list++) {
+	struct watchlist_t *wl =
+	    &watchers[list ? WATCH_ALL : (int)(device - devices)];
+
+	/* backwards, as a failed write detaches the client */
+	for (i = wl->count - 1; i >= 0; i--) {
+	    sub = wl->subs[i];
 
 #ifdef PASSTHROUGH_ENABLE
-	/* this is for passing through JSON packets */
-	if ((changed & PASSTHROUGH_IS) != 0) {
-	    (void)strlcat((char *)device->lexer.outbuffer,
-			  "\r\n",
-			  sizeof(device->lexer.outbuffer));
-	    (void)throttled_write(sub,
-				  (char *)device->lexer.outbuffer,
-				  device->lexer.outbuflen+2);
-	    continue;
-	}
+	    /* this is for passing through JSON packets */
+	    if ((changed & PASSTHROUGH_IS) != 0) {
+		(void)strlcat((char *)device->lexer.outbuffer,
+			      "\r\n",
+			      sizeof(device->lexer.outbuf));
+		(void)throttled_write(sub,
+				      (char *)device->lexer.outbuffer,
+				      device->lexer.outbuflen+2);
+		continue;
+	    }
 #endif /* PASSTHROUGH_ENABLE */
 
-	/* report raw packets to users subscribed to those */
-	raw_report(sub, device);
-
-	/* some listeners may be in watcher mode */
-	if (sub->policy.watcher) {
-	    if (changed & DATA_IS) {
-                GPSD_LOG(LOG_PROG, &context.errout,
-                         "Changed mask: %s with %sreliable "
-                         "cycle detection\n",
-                         gps_maskdump(changed),
-                         device->cycle_end_reliable ? "" : "un");
-		if ((changed & REPORT_IS) != 0)
-		    GPSD_LOG(LOG_PROG, &context.errout,
-			     "time to report a fix\n");
-
-		if (sub->policy.nmea)
-		    pseudonmea_report(sub, changed, device);
+	    /* report raw packets to users subscribed to those */
+	    raw_report(sub, device, &rawcopy, &rawhex);
 
-		if (sub->policy.json) {
-		    char buf[GPS_JSON_RESPONSE_MAX * 4];
-
-		    if ((changed & AIS_SET) != 0)
-			if (device->gpsdata.ais.type == 24
-			    && device->gpsdata.ais.type24.part != both
-			    && !sub->policy.split24)
+	    /* some listeners may be in watcher mode */
+	    if (sub->policy.watcher) {
+		if (changed & DATA_IS) {
+		    GPSD_LOG(LOG_PROG, &context.errout,
+			     "Changed mask: %s with %sreliable "
+			     "cycle detection\n",
+			     gps_maskdump(changed),
+			     device->cycle_end_reliable ? "" : "un");
+		    if ((changed & REPORT_IS) != 0)
+			GPSD_LOG(LOG_PROG, &context.errout,
+				 "time to report a fix\n");
+
+		    if (sub->policy.nmea)
+			pseudonmea_report(sub, changed, device);
+
+		    if (sub->policy.json) {
+			unsigned int variant = json_variant(&sub->policy);
+			unsigned int full;
+			char *text;
+			size_t textlen;
+
+			if ((changed & AIS_SET) != 0)
+			    if (device->gpsdata.ais.type == 24
+				&& device->gpsdata.ais.type24.part != both
+				&& !sub->policy.split24)
+				continue;
+
+			/* deltas are cut from the whole encoding */
+			full = variant & ~JSON_VARIANT_DELTA;
+			if (!json_cached[full]) {
+			    char *jbuf = json_cache[full].buf;
+			    size_t blen = 0;
+			    gps_mask_t rest = changed;
+
+			    /* TPV and SKY as binary records, the rest JSON */
+			    if (sub->policy.binary) {
+				blen = binary_data_report(changed, device, jbuf,
+				    sizeof(json_cache[full].buf));
+				rest &= ~(REPORT_IS | SATELLITE_SET);
+			    }
+			    json_data_report(rest, device, &sub->policy,
+				jbuf + blen,
+				sizeof(json_cache[full].buf) - blen);
+			    json_cache[full].len = blen + strlen(jbuf + blen);
+			    json_cached[full] = true;
+			}
+			if (variant != full) {
+			    int v = (0 != (full & JSON_VARIANT_SCALED));
+
+			    delta_from[v] = true;
+			    /* after a loss, whole reports until each class
+			     * has gone whole once */
+			    lock_subscriber(sub);
+			    if (0 != sub->delta_whole) {
+				sub->delta_whole &=
+				    ~delta_classes_in(json_cache[full].buf,
+						      json_cache[full].len);
+				variant = full;
+			    }
+			    unlock_subscriber(sub);
+			}
+			if (!json_cached[variant]) {
+			    int v = (0 != (full & JSON_VARIANT_SCALED));
+
+			    json_cache[variant].len =
+				delta_report(device, v, json_cache[full].buf,
+					     json_cache[full].len,
+					     json_cache[variant].buf,
+					     sizeof(json_cache[variant].buf));
+			    json_cached[variant] = true;
+			}
+			text = json_cache[variant].buf;
+			textlen = json_cache[variant].len;
+			if ('\0' != sub->policy.fields[0]) {
+			    unsigned int p;
+
+			    for (p = 0; p < nproj && p < PROJECTIONS; p++)
+				if (proj_cache[p].variant == variant
+				    && 0 == strcmp(proj_cache[p].fields,
+						   sub->policy.fields))
+				    break;
+			    if (p == nproj || PROJECTIONS == p) {
+				p = nproj++ % PROJECTIONS;
+				proj_cache[p].variant = variant;
+				(void)strlcpy(proj_cache[p].fields,
+					      sub->policy.fields,
+					      sizeof(proj_cache[p].fields));
+				proj_cache[p].len =
+				    project_report(sub->policy.fields,
+						   json_cache[variant].buf,
+						   json_cache[variant].len,
+						   proj_cache[p].buf,
+						   sizeof(proj_cache[p].buf));
+			    }
+			    text = proj_cache[p].buf;
+			    textlen = proj_cache[p].len;
+			}
+			if (0 == textlen)
 			    continue;
+			if (0 < sub->policy.interval
+			    || 0 < sub->policy.aisinterval)
+			    decimated_write(sub, device, text, textlen);
+			else
+			    (void)throttled_write(sub, text, textlen);
 
-		    json_data_report(changed, device, &sub->policy,
-				     buf, sizeof(buf));
-		    if (buf[0] != '\0')
-			(void)throttled_write(sub, buf, strlen(buf));
-
+		    }
 		}
 	    }
 	}
     } /* subscribers */
+    unlock_clients();
+    shared_release(rawcopy);
+    shared_release(rawhex);
+
+    for (i = 0; i < DELTA_VARIANTS; i++)
+	if (delta_from[i]) {
+	    unsigned int full = (0 < i) ? JSON_VARIANT_SCALED : 0;
+
+	    delta_update(device, i, json_cache[full].buf,
+			 json_cache[full].len);
+	}
 #endif /* SOCKET_EXPORT_ENABLE */
 }
 
@@ -1698,6 +3052,7 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
 static int handle_gpsd_request(struct subscriber_t *sub, const char *buf)
 {
     char reply[GPS_JSON_RESPONSE_MAX + 1];
+    int status;
 
     reply[0] = '\0';
     if (buf[0] == '?') {
@@ -1705,15 +3060,175 @@ static int handle_gpsd_request(struct subscriber_t *sub, const char *buf)
 	for (end = buf; *buf != '\0'; buf = end)
 	    if (isspace((unsigned char) *buf))
 		end = buf + 1;
-	    else
+	    else {
 		handle_request(sub, buf, &end,
 			       reply + strlen(reply),
 			       sizeof(reply) - strlen(reply));
+#ifdef ZLIB_ENABLE
+		/*
+		 * The stream is compressed from just after the WATCH that
+		 * asked, so send what we have plain and compress the
+		 * replies to any requests after it in this buffer.
+		 */
+		if (sub->policy.compress && NULL == sub->deflater) {
+		    status = (int)throttled_write(sub, reply, strlen(reply));
+		    if (0 > status)
+			return status;
+		    reply[0] = '\0';
+		    if (!deflate_start(sub))
+			GPSD_LOG(LOG_WARN, &context.errout,
+				 "client(%d) compression failed to start\n",
+				 sub_index(sub));
+		}
+#endif /* ZLIB_ENABLE */
+	    }
+    }
+    status = (int)throttled_write(sub, reply, strlen(reply));
+    return status;
+}
+#endif /* SOCKET_EXPORT_ENABLE */
+
+#ifdef SOCKET_EXPORT_ENABLE
+static void accept_client(socket_t msock)
+/* accept a new client connection on a listening socket */
+{
+    sockaddr_t fsin;
+    socklen_t alen = (socklen_t) sizeof(fsin);
+    socket_t ssock = accept(msock, (struct sockaddr *)&fsin, &alen);
+
+    if (BAD_SOCKET(ssock))
+	GPSD_LOG(LOG_ERROR, &context.errout,
+		 "accept: fail: %s\n", strerror(errno));
+    else {
+	struct subscriber_t *client = NULL;
+	int opts = fcntl(ssock, F_GETFL);
+	static struct linger linger = { 1, RELEASE_TIMEOUT };
+	char *c_ip;
+
+	if (opts >= 0)
+	    (void)fcntl(ssock, F_SETFL, opts | O_NONBLOCK);
+
+	c_ip = netlib_sock2ip(ssock);
+	client = allocate_client();
+	if (client == NULL) {
+	    GPSD_LOG(LOG_ERROR, &context.errout,
+		     "Client %s connect on fd %d -"
+		     "no subscriber slots available\n", c_ip,
+			ssock);
+	    (void)close(ssock);
+	} else
+	    if (setsockopt
+		(ssock, SOL_SOCKET, SO_LINGER, (char *)&linger,
+		 (int)sizeof(struct linger)) == -1) {
+	    GPSD_LOG(LOG_ERROR, &context.errout,
+		     "Error: SETSOCKOPT SO_LINGER\n");
+	    release_client(client);
+	    (void)close(ssock);
+	} else if (!gpsd_evloop_add(&evloop, ssock, EVLOOP_READ,
+				    watch_client, client)) {
+	    release_client(client);
+	    (void)close(ssock);
+	} else {
+	    char announce[GPS_JSON_RESPONSE_MAX];
+
+	    client->fd = ssock;
+	    client->active = time(NULL);
+#ifdef SOCK_SEQPACKET
+	    {
+		int type;
+		socklen_t tlen = (socklen_t)sizeof(type);
+
+		client->framed =
+		    0 == getsockopt(ssock, SOL_SOCKET, SO_TYPE, &type, &tlen)
+		    && SOCK_SEQPACKET == type;
+	    }
+#endif /* SOCK_SEQPACKET */
+	    GPSD_LOG(LOG_SPIN, &context.errout,
+		     "client %s (%d) connect on fd %d\n", c_ip,
+		     sub_index(client), ssock);
+	    json_version_dump(announce, sizeof(announce));
+	    (void)throttled_write(client, announce,
+				  strlen(announce));
+	}
+    }
+}
+
+static void handle_client(struct subscriber_t *sub)
+/* read and execute commands from a client whose socket is readable */
+{
+    char buf[BUFSIZ];
+    int buflen;
+
+    GPSD_LOG(LOG_PROG, &context.errout,
+	     "checking client(%d)\n",
+	     sub_index(sub));
+    if ((buflen =
+	 (int)recv(sub->fd, buf, sizeof(buf) - 1, 0)) <= 0) {
+	/* a stale readiness report, perhaps for an earlier owner of fd */
+	if (buflen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	    return;
+	detach_client(sub);
+    } else {
+	if (buf[buflen - 1] != '\n')
+	    buf[buflen++] = '\n';
+	buf[buflen] = '\0';
+	GPSD_LOG(LOG_CLIENT, &context.errout,
+		 "<= client(%d): %s\n", sub_index(sub), buf);
+
+	/*
+	 * When a command comes in, update subscriber.active to
+	 * timestamp() so we don't close the connection
+	 * after COMMAND_TIMEOUT seconds. This makes
+	 * COMMAND_TIMEOUT useful.
+	 */
+	sub->active = time(NULL);
+	if (handle_gpsd_request(sub, buf) < 0)
+	    detach_client(sub);
     }
-    return (int)throttled_write(sub, reply, strlen(reply));
 }
 #endif /* SOCKET_EXPORT_ENABLE */
 
+#ifdef CONTROL_SOCKET_ENABLE
+static void accept_control(socket_t csock)
+/* accept a new connection on the control socket */
+{
+    sockaddr_t fsin;
+    socklen_t alen = (socklen_t) sizeof(fsin);
+    socket_t ssock = accept(csock, (struct sockaddr *)&fsin, &alen);
+
+    if (BAD_SOCKET(ssock))
+	GPSD_LOG(LOG_ERROR, &context.errout,
+		 "accept: %s\n", strerror(errno));
+    else {
+	GPSD_LOG(LOG_INF, &context.errout,
+		 "control socket connect on fd %d\n",
+		 ssock);
+	if (!gpsd_evloop_add(&evloop, ssock, EVLOOP_READ,
+			     watch_control, NULL))
+	    (void)close(ssock);
+    }
+}
+
+static void read_control(socket_t cfd)
+/* read any commands that came in over a control connection, then close */
+{
+    char buf[BUFSIZ];
+    ssize_t rd;
+
+    while ((rd = read(cfd, buf, sizeof(buf) - 1)) > 0) {
+	buf[rd] = '\0';
+	GPSD_LOG(LOG_CLIENT, &context.errout,
+		 "<= control(%d): %s\n", cfd, buf);
+	/* coverity[tainted_data] Safe, never handed to exec */
+	handle_control(cfd, buf);
+    }
+    GPSD_LOG(LOG_SPIN, &context.errout,
+	     "close(%d) of control socket\n", cfd);
+    gpsd_evloop_remove(&evloop, cfd);
+    (void)close(cfd);
+}
+#endif /* CONTROL_SOCKET_ENABLE */
+
 #if defined(CONTROL_SOCKET_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
 static void ship_pps_message(struct gps_device_t *session,
 				   struct timedelta_t *td)
@@ -1848,8 +3363,12 @@ static void gpsd_terminate(struct gps_context_t *context)
 
     for (dfd = 0; dfd < MAX_DEVICES; dfd++) {
 	if (allocated_device(&devices[dfd])) {
+	    device_watch(&devices[dfd], false);
 	    (void)gpsd_wrap(&devices[dfd]);
 	}
+#ifdef SHM_EXPORT_ENABLE
+	shm_device_release(context, &devices[dfd]);
+#endif /* SHM_EXPORT_ENABLE */
     }
     context->pps_hook = NULL;	/* tell any PPS-watcher thread to die */
 }
@@ -1860,20 +3379,21 @@ int main(int argc, char *argv[])
 #ifdef SOCKET_EXPORT_ENABLE
     static char *gpsd_service = NULL;
     struct subscriber_t *sub;
+    static time_t last_sweep = 0;
 #endif /* SOCKET_EXPORT_ENABLE */
-    fd_set rfds;
-#ifdef CONTROL_SOCKET_ENABLE
-    fd_set control_fds;
-#endif /* CONTROL_SOCKET_ENABLE */
 #ifdef CONTROL_SOCKET_ENABLE
     static socket_t csock;
-    socket_t cfd;
     static char *control_socket = NULL;
 #endif /* CONTROL_SOCKET_ENABLE */
-#if defined(SOCKET_EXPORT_ENABLE) || defined(CONTROL_SOCKET_ENABLE)
-    sockaddr_t fsin;
-#endif /* defined(SOCKET_EXPORT_ENABLE) || defined(CONTROL_SOCKET_ENABLE) */
     static char *pid_file = NULL;
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+    static char *udp_group = NULL;
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
+#if defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET)
+    static socket_t lsock = -1;
+    static char *local_socket = NULL;
+#endif /* defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET) */
+    static int first_device = 0;
     struct gps_device_t *device;
     int i, option;
     int msocks[2] = {-1, -1};
@@ -1882,6 +3402,9 @@ int main(int argc, char *argv[])
     volatile bool in_restart;
 
     gps_context_init(&context, "gpsd");
+    context.poll_packets = POLL_PACKETS;
+    (void)gpsd_evloop_init(&evloop, &context.errout);
+    context.close_hook = device_closing;
 
 #ifdef CONTROL_SOCKET_ENABLE
     INVALIDATE_SOCKET(csock);
@@ -1890,8 +3413,25 @@ int main(int argc, char *argv[])
 #endif /* SOCKET_EXPORT_ENABLE */
 #endif /* CONTROL_SOCKET_ENABLE */
 
-    while ((option = getopt(argc, argv, "bD:F:f:GhlNnP:rS:s:V")) != -1) {
+    while ((option = getopt(argc, argv, "B:bD:F:f:GhL:lNnP:Q:rS:s:U:V")) != -1) {
 	switch (option) {
+	case 'B':
+            {
+                char *end;
+                long packets = strtol(optarg, &end, 0);
+                long bytes = 0;
+
+                if (',' == *end)
+                    bytes = strtol(end + 1, &end, 0);
+                if (0 > packets || 0 > bytes || '\0' != *end) {
+                    GPSD_LOG(LOG_ERROR, &context.errout,
+                             "-B has invalid budget %s\n", optarg);
+                    exit(1);
+                }
+                context.poll_packets = (unsigned int)packets;
+                context.poll_bytes = (size_t)bytes;
+            }
+	    break;
 	case 'b':
 	    context.readonly = true;
 	    break;
@@ -1929,6 +3469,11 @@ int main(int argc, char *argv[])
 	    listen_global = true;
 	    break;
 #endif /* FORCE_GLOBAL_ENABLE */
+	case 'L':
+#if defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET)
+	    local_socket = optarg;
+#endif /* defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET) */
+	    break;
 	case 'l':		/* list known device types and exit */
 	    typelist();
 	    break;
@@ -1941,6 +3486,33 @@ int main(int argc, char *argv[])
 	case 'P':
 	    pid_file = optarg;
 	    break;
+	case 'Q':
+#ifdef SOCKET_EXPORT_ENABLE
+            {
+                char *end;
+                long limit = strtol(optarg, &end, 0);
+
+                if (QUEUE_LIMIT_MIN > limit) {
+                    GPSD_LOG(LOG_ERROR, &context.errout,
+                             "-Q limit %ld is less than the minimum %d\n",
+                             limit, QUEUE_LIMIT_MIN);
+                    exit(1);
+                }
+                queue_limit = (size_t)limit;
+                if ('\0' == *end)
+                    break;
+                if (0 == strcmp(end, ",coalesce"))
+                    queue_policy = queue_coalesce;
+                else if (0 == strcmp(end, ",drop"))
+                    queue_policy = queue_drop;
+                else {
+                    GPSD_LOG(LOG_ERROR, &context.errout,
+                             "-Q has invalid policy %s\n", end);
+                    exit(1);
+                }
+            }
+#endif /* SOCKET_EXPORT_ENABLE */
+	    break;
 	case 'r':
 	    batteryRTC = true;
 	    break;
@@ -1964,6 +3536,11 @@ int main(int argc, char *argv[])
                 }
             }
 	    break;
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+	case 'U':
+	    udp_group = optarg;
+	    break;
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
 	case 'V':
 	    (void)printf("%s: %s (revision %s)\n", argv[0], VERSION, REVISION);
 	    exit(EXIT_SUCCESS);
@@ -2024,14 +3601,14 @@ int main(int argc, char *argv[])
 #if defined(SYSTEMD_ENABLE) && defined(CONTROL_SOCKET_ENABLE)
     if (sd_socket_count > 0) {
         csock = SD_SOCKET_FDS_START;
-        FD_SET(csock, &all_fds);
-        adjust_max_fd(csock, true);
+        (void)gpsd_evloop_add(&evloop, csock, EVLOOP_READ,
+                              watch_control_listener, NULL);
     }
 #endif
 #ifdef CONTROL_SOCKET_ENABLE
     if (control_socket) {
 	(void)unlink(control_socket);
-	if (BAD_SOCKET(csock = filesock(control_socket))) {
+	if (BAD_SOCKET(csock = filesock(control_socket, SOCK_STREAM))) {
 	    GPSD_LOG(LOG_ERROR, &context.errout,
 		     "control socket create failed, netlib error %d\n",
 		     csock);
@@ -2040,8 +3617,8 @@ int main(int argc, char *argv[])
 	    GPSD_LOG(LOG_SPIN, &context.errout,
 		     "control socket %s is fd %d\n",
 		     control_socket, csock);
-	FD_SET(csock, &all_fds);
-	adjust_max_fd(csock, true);
+	(void)gpsd_evloop_add(&evloop, csock, EVLOOP_READ,
+			      watch_control_listener, NULL);
 	GPSD_LOG(LOG_PROG, &context.errout,
 		 "control socket opened at %s\n",
 		 control_socket);
@@ -2094,6 +3671,20 @@ int main(int argc, char *argv[])
     }
     GPSD_LOG(LOG_INF, &context.errout, "listening on port %s\n",
                        gpsd_service);
+#ifdef SOCK_SEQPACKET
+    if (NULL != local_socket) {
+	(void)unlink(local_socket);
+	if (BAD_SOCKET(lsock = filesock(local_socket, SOCK_SEQPACKET))) {
+	    if (pid_file != NULL)
+		(void)unlink(pid_file);
+	    exit(EXIT_FAILURE);
+	}
+	/* as open to local users as the TCP port is */
+	(void)chmod(local_socket, 0666);
+	GPSD_LOG(LOG_INF, &context.errout, "listening on %s\n",
+		 local_socket);
+    }
+#endif /* SOCK_SEQPACKET */
 #endif /* SOCKET_EXPORT_ENABLE */
 
     if (getuid() == 0) {
@@ -2128,6 +3719,11 @@ int main(int argc, char *argv[])
     (void)shm_acquire(&context);
 #endif /* SHM_EXPORT_ENABLE */
 
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+    if (NULL != udp_group && !udp_acquire(&context, udp_group))
+	exit(EXIT_FAILURE);
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
+
     /*
      * We open devices specified on the command line *before* dropping
      * privileges in case one of them is a serial device with PPS support
@@ -2213,9 +3809,14 @@ int main(int argc, char *argv[])
 	     "running with effective user ID %d\n", geteuid());
 
 #ifdef SOCKET_EXPORT_ENABLE
-    for (i = 0; i < NITEMS(subscribers); i++) {
-	subscribers[i].fd = UNALLOCATED_FD;
-	(void)pthread_mutex_init(&subscribers[i].mutex, NULL);
+    {
+	pthread_mutexattr_t attr;
+
+	(void)pthread_mutexattr_init(&attr);
+	(void)pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	(void)pthread_mutex_init(&clients_mutex, &attr);
+	(void)pthread_mutexattr_destroy(&attr);
+	main_thread = pthread_self();
     }
 #endif /* SOCKET_EXPORT_ENABLE*/
 
@@ -2250,13 +3851,14 @@ int main(int argc, char *argv[])
     signalled = 0;
 
     for (i = 0; i < AFCOUNT; i++)
-	if (msocks[i] >= 0) {
-	    FD_SET(msocks[i], &all_fds);
-	    adjust_max_fd(msocks[i], true);
-	}
-#ifdef CONTROL_SOCKET_ENABLE
-    FD_ZERO(&control_fds);
-#endif /* CONTROL_SOCKET_ENABLE */
+	if (msocks[i] >= 0)
+	    (void)gpsd_evloop_add(&evloop, msocks[i], EVLOOP_READ,
+				  watch_listener, NULL);
+#if defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET)
+    if (!BAD_SOCKET(lsock))
+	(void)gpsd_evloop_add(&evloop, lsock, EVLOOP_READ,
+			      watch_listener, NULL);
+#endif /* defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET) */
 
     /* initialize the GPS context's time fields */
     gpsd_time_init(&context, time(NULL));
@@ -2276,150 +3878,113 @@ int main(int argc, char *argv[])
 	}
 
     while (0 == signalled) {
-	fd_set efds;
-
-        GPSD_LOG(LOG_RAW + 1, &context.errout, "await data\n");
-	switch(gpsd_await_data(&rfds, &efds, maxfd, &all_fds, &context.errout))
-	{
-	case AWAIT_GOT_INPUT:
-	    break;
-	case AWAIT_NOT_READY:
-	    for (device = devices; device < devices + MAX_DEVICES; device++)
-		/*
-		 * The file descriptor validity check is required on some ARM
-		 * platforms to prevent a core dump.  This may be due to an
-		 * implimentation error in FD_ISSET().
-		 */
-		if (allocated_device(device)
-		    && (0 <= device->gpsdata.gps_fd && device->gpsdata.gps_fd < (socket_t)FD_SETSIZE)
-		    && FD_ISSET(device->gpsdata.gps_fd, &efds)) {
-		    deactivate_device(device);
-		    free_device(device);
-		}
-	    continue;
-	case AWAIT_FAILED:
-	    exit(EXIT_FAILURE);
-	}
-
+	struct evloop_event_t events[EVLOOP_MAXEVENTS];
+	bool device_ready[MAX_DEVICES];
 #ifdef SOCKET_EXPORT_ENABLE
-	/* always be open to new client connections */
-	for (i = 0; i < AFCOUNT; i++) {
-	    if (msocks[i] >= 0 && FD_ISSET(msocks[i], &rfds)) {
-		socklen_t alen = (socklen_t) sizeof(fsin);
-		socket_t ssock =
-		    accept(msocks[i], (struct sockaddr *)&fsin, &alen);
-
-		if (BAD_SOCKET(ssock))
-		    GPSD_LOG(LOG_ERROR, &context.errout,
-			     "accept: fail: %s\n", strerror(errno));
-		else {
-		    struct subscriber_t *client = NULL;
-		    int opts = fcntl(ssock, F_GETFL);
-		    static struct linger linger = { 1, RELEASE_TIMEOUT };
-		    char *c_ip;
+	struct subscriber_t *readable[EVLOOP_MAXEVENTS];
+	int nreadable = 0;
+#endif /* SOCKET_EXPORT_ENABLE */
+	const timespec_t nowait_ts = {0, 0};
+	bool pending = false;
+	int nevents, n;
 
-		    if (opts >= 0)
-			(void)fcntl(ssock, F_SETFL, opts | O_NONBLOCK);
+	for (device = devices; device < devices + MAX_DEVICES; device++)
+	    if (allocated_device(device) && device->gpsdata.gps_fd > 0)
+		pending |= device->overbudget;
 
-		    c_ip = netlib_sock2ip(ssock);
-		    client = allocate_client();
-		    if (client == NULL) {
-			GPSD_LOG(LOG_ERROR, &context.errout,
-				 "Client %s connect on fd %d -"
-				 "no subscriber slots available\n", c_ip,
-				    ssock);
-			(void)close(ssock);
-		    } else
-			if (setsockopt
-			    (ssock, SOL_SOCKET, SO_LINGER, (char *)&linger,
-			     (int)sizeof(struct linger)) == -1) {
-			GPSD_LOG(LOG_ERROR, &context.errout,
-				 "Error: SETSOCKOPT SO_LINGER\n");
-			(void)close(ssock);
-		    } else {
-			char announce[GPS_JSON_RESPONSE_MAX];
-			FD_SET(ssock, &all_fds);
-			adjust_max_fd(ssock, true);
-			client->fd = ssock;
-			client->active = time(NULL);
-			GPSD_LOG(LOG_SPIN, &context.errout,
-				 "client %s (%d) connect on fd %d\n", c_ip,
-				 sub_index(client), ssock);
-			json_version_dump(announce, sizeof(announce));
-			(void)throttled_write(client, announce,
-					      strlen(announce));
-		    }
-		}
-		FD_CLR(msocks[i], &rfds);
-	    }
-	}
+#ifdef SOCKET_EXPORT_ENABLE
+	flush_batched();
 #endif /* SOCKET_EXPORT_ENABLE */
+        GPSD_LOG(LOG_RAW + 1, &context.errout, "await data\n");
+	/* don't sleep while some device still has buffered input */
+	nevents = gpsd_evloop_wait(&evloop, events, (int)NITEMS(events),
+				   pending ? &nowait_ts : NULL);
+	if (nevents < 0)
+	    exit(EXIT_FAILURE);
+	else if (nevents == 0 && !pending)
+	    continue;
 
-#ifdef CONTROL_SOCKET_ENABLE
-	/* also be open to new control-socket connections */
-	if (csock > -1 && FD_ISSET(csock, &rfds)) {
-	    socklen_t alen = (socklen_t) sizeof(fsin);
-	    socket_t ssock = accept(csock, (struct sockaddr *)&fsin, &alen);
-
-	    if (BAD_SOCKET(ssock))
-		GPSD_LOG(LOG_ERROR, &context.errout,
-			 "accept: %s\n", strerror(errno));
-	    else {
-		GPSD_LOG(LOG_INF, &context.errout,
-			 "control socket connect on fd %d\n",
-			 ssock);
-		FD_SET(ssock, &all_fds);
-		FD_SET(ssock, &control_fds);
-		adjust_max_fd(ssock, true);
-	    }
-	    FD_CLR(csock, &rfds);
-	}
-
-	/* read any commands that came in over the control socket */
-        GPSD_LOG(LOG_RAW + 1, &context.errout, "read control commands");
-	for (cfd = 0; cfd < (int)FD_SETSIZE; cfd++)
-	    if (FD_ISSET(cfd, &control_fds)) {
-		char buf[BUFSIZ];
-		ssize_t rd;
-
-		while ((rd = read(cfd, buf, sizeof(buf) - 1)) > 0) {
-		    buf[rd] = '\0';
-		    GPSD_LOG(LOG_CLIENT, &context.errout,
-			     "<= control(%d): %s\n", cfd, buf);
-		    /* coverity[tainted_data] Safe, never handed to exec */
-		    handle_control(cfd, buf);
-		}
-		GPSD_LOG(LOG_SPIN, &context.errout,
-			 "close(%d) of control socket\n", cfd);
-		(void)close(cfd);
-		FD_CLR(cfd, &all_fds);
-		FD_CLR(cfd, &control_fds);
-		adjust_max_fd(cfd, false);
-	    }
-#endif /* CONTROL_SOCKET_ENABLE */
+	for (n = 0; n < MAX_DEVICES; n++)
+	    device_ready[n] = devices[n].overbudget;
+	for (n = 0; n < nevents; n++) {
+	    struct evloop_event_t *ev = &events[n];
 
-	/* poll all active devices */
-        GPSD_LOG(LOG_RAW + 1, &context.errout, "poll active devices");
-	for (device = devices; device < devices + MAX_DEVICES; device++)
-	    if (allocated_device(device) && device->gpsdata.gps_fd > 0)
-		switch (gpsd_multipoll(FD_ISSET(device->gpsdata.gps_fd, &rfds),
-				       device, all_reports, DEVICE_REAWAKE))
-		{
-		case DEVICE_READY:
-		    FD_SET(device->gpsdata.gps_fd, &all_fds);
-		    adjust_max_fd(device->gpsdata.gps_fd, true);
-		    break;
-		case DEVICE_UNREADY:
-		    FD_CLR(device->gpsdata.gps_fd, &all_fds);
-		    adjust_max_fd(device->gpsdata.gps_fd, false);
+	    switch (ev->tag) {
+	    case watch_device:
+		device = (struct gps_device_t *)ev->data;
+		if (!allocated_device(device)
+		    || device->gpsdata.gps_fd != ev->fd)
 		    break;
-		case DEVICE_ERROR:
-		case DEVICE_EOF:
+		if ((ev->events & EVLOOP_BADFD) != 0) {
 		    deactivate_device(device);
-		    break;
-		default:
+		    free_device(device);
+		} else
+		    device_ready[device - devices] = true;
+		break;
+#ifdef SOCKET_EXPORT_ENABLE
+	    case watch_listener:
+		/* always be open to new client connections */
+		accept_client(ev->fd);
+		break;
+	    case watch_client:
+		sub = (struct subscriber_t *)ev->data;
+		if ((ev->events & EVLOOP_BADFD) != 0) {
+		    detach_client(sub);
 		    break;
 		}
+		if ((ev->events & EVLOOP_WRITE) != 0)
+		    flush_client(sub);
+		if ((ev->events & EVLOOP_READ) != 0 && sub->active != 0)
+		    readable[nreadable++] = sub;
+		break;
+#endif /* SOCKET_EXPORT_ENABLE */
+#ifdef CONTROL_SOCKET_ENABLE
+	    case watch_control_listener:
+		/* also be open to new control-socket connections */
+		accept_control(ev->fd);
+		break;
+	    case watch_control:
+		/* read any commands that came in over the control socket */
+		read_control(ev->fd);
+		break;
+#endif /* CONTROL_SOCKET_ENABLE */
+	    default:
+		GPSD_LOG(LOG_WARN, &context.errout,
+			 "event on unexpected fd %d\n", ev->fd);
+		gpsd_evloop_remove(&evloop, ev->fd);
+		break;
+	    }
+	}
+
+	/*
+	 * Poll all active devices, round-robin so that no device is
+	 * always first in line.  Each gets at most its packet budget
+	 * per pass; one left with input still buffered is serviced
+	 * again next pass without waiting for its fd.
+	 */
+        GPSD_LOG(LOG_RAW + 1, &context.errout, "poll active devices\n");
+	for (n = 0; n < MAX_DEVICES; n++) {
+	    device = &devices[(first_device + n) % MAX_DEVICES];
+	    if (!allocated_device(device) || device->gpsdata.gps_fd <= 0)
+		continue;
+	    switch (gpsd_multipoll(device_ready[device - devices],
+				   device, all_reports, DEVICE_REAWAKE))
+	    {
+	    case DEVICE_READY:
+		device_watch(device, true);
+		break;
+	    case DEVICE_UNREADY:
+		device_watch(device, false);
+		break;
+	    case DEVICE_ERROR:
+	    case DEVICE_EOF:
+		deactivate_device(device);
+		break;
+	    default:
+		break;
+	    }
+	}
+	first_device = (first_device + 1) % MAX_DEVICES;
 
 #ifdef __UNUSED_AUTOCONNECT__
 	if (context.fixcnt > 0 && !context.autconnect) {
@@ -2436,52 +4001,37 @@ int main(int argc, char *argv[])
 #endif /* __UNUSED_AUTOCONNECT__ */
 
 #ifdef SOCKET_EXPORT_ENABLE
-	/* accept and execute commands for all clients */
-	for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
-	    if (sub->active == 0)
-		continue;
-
-	    lock_subscriber(sub);
-	    if (FD_ISSET(sub->fd, &rfds)) {
-		char buf[BUFSIZ];
-		int buflen;
-
-		unlock_subscriber(sub);
-
-		GPSD_LOG(LOG_PROG, &context.errout,
-			 "checking client(%d)\n",
-			 sub_index(sub));
-		if ((buflen =
-		     (int)recv(sub->fd, buf, sizeof(buf) - 1, 0)) <= 0) {
-		    detach_client(sub);
-		} else {
-		    if (buf[buflen - 1] != '\n')
-			buf[buflen++] = '\n';
-		    buf[buflen] = '\0';
-		    GPSD_LOG(LOG_CLIENT, &context.errout,
-			     "<= client(%d): %s\n", sub_index(sub), buf);
-
-		    /*
-		     * When a command comes in, update subscriber.active to
-		     * timestamp() so we don't close the connection
-		     * after COMMAND_TIMEOUT seconds. This makes
-		     * COMMAND_TIMEOUT useful.
-		     */
-		    sub->active = time(NULL);
-		    if (handle_gpsd_request(sub, buf) < 0)
-			detach_client(sub);
-		}
-	    } else {
-		unlock_subscriber(sub);
+	/* accept and execute commands for clients with pending input */
+	for (n = 0; n < nreadable; n++) {
+	    sub = readable[n];
+	    /* the client may have been detached while polling devices */
+	    if (sub->active != 0 && !BAD_SOCKET(sub->fd))
+		handle_client(sub);
+	}
 
+	/* client timeouts need only be checked once a second */
+	if (time(NULL) != last_sweep) {
+	    last_sweep = time(NULL);
+	    lock_clients();
+	    for (n = nclients - 1; n >= 0; n--) {
+		sub = clients[n];
+		if (sub->active == 0)
+		    continue;
 		if (!sub->policy.watcher
-		    && time(NULL) - sub->active > COMMAND_TIMEOUT) {
+		    && last_sweep - sub->active > COMMAND_TIMEOUT) {
 		    GPSD_LOG(LOG_WARN, &context.errout,
 			     "client(%d) timed out on command wait.\n",
 			     sub_index(sub));
 		    detach_client(sub);
+		} else if (sub->queue.count > 0
+			   && last_sweep - sub->queue.progress
+			       > NOREAD_TIMEOUT) {
+		    GPSD_LOG(LOG_INF, &context.errout,
+			     "client(%d) timed out.\n", sub_index(sub));
+		    detach_client(sub);
 		}
 	    }
+	    unlock_clients();
 	}
 
 	/*
@@ -2499,14 +4049,12 @@ int main(int argc, char *argv[])
 	    if (!allocated_device(device))
 		continue;
 
-	    if (!device_needed)
-		for (sub=subscribers; sub<subscribers+MAX_CLIENTS; sub++) {
-		    if (sub->active == 0)
-			continue;
-		    device_needed = subscribed(sub, device);
-		    if (device_needed)
-			break;
-		}
+	    if (!device_needed) {
+		lock_clients();
+		device_needed = 0 < watchers[device - devices].count
+				|| 0 < watchers[WATCH_ALL].count;
+		unlock_clients();
+	    }
 
 	    if (!device_needed && device->gpsdata.gps_fd > -1 &&
 		    device->lexer.type != BAD_PACKET) {
@@ -2553,9 +4101,11 @@ int main(int argc, char *argv[])
 	if (argc == optind && highwater > 0) {
 	    int subcount = 0, devcount = 0;
 #ifdef SOCKET_EXPORT_ENABLE
-	    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++)
-		if (sub->active != 0)
+	    lock_clients();
+	    for (n = 0; n < nclients; n++)
+		if (clients[n]->active != 0)
 		    ++subcount;
+	    unlock_clients();
 #endif /* SOCKET_EXPORT_ENABLE */
 	    for (device = devices; device < devices + MAX_DEVICES; device++)
 		if (allocated_device(device))
@@ -2587,22 +4137,31 @@ shutdown:
      * This is an attempt to avoid the sporadic race errors at the ends
      * of our regression tests.
      */
-    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
-	if (sub->active != 0)
-	    detach_client(sub);
-    }
+    lock_clients();
+    for (i = nclients - 1; i >= 0; i--)
+	detach_client(clients[i]);
+    unlock_clients();
 #endif /* SOCKET_EXPORT_ENABLE */
 
 #ifdef SHM_EXPORT_ENABLE
     shm_release(&context);
 #endif /* SHM_EXPORT_ENABLE */
 
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+    udp_release(&context);
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
+
 #ifdef CONTROL_SOCKET_ENABLE
     if (control_socket)
 	(void)unlink(control_socket);
 #endif /* CONTROL_SOCKET_ENABLE */
+#if defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET)
+    if (local_socket)
+	(void)unlink(local_socket);
+#endif /* defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET) */
     if (pid_file)
 	(void)unlink(pid_file);
+    gpsd_evloop_close(&evloop);
     return 0;
 }
 
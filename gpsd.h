@@ -230,12 +230,25 @@ struct gps_lexer_t {
 #define GPS_TYPEMASK	(((2<<(MAX_GPSPACKET_TYPE+1))-1) &~ PACKET_TYPEMASK(COMMENT_PACKET))
     unsigned int state;
     size_t length;
-    unsigned char inbuffer[MAX_PACKET_LENGTH*2+1];
+    /*
+     * Unread input is the window of inbuflen bytes at inbuffer, which
+     * slides along inbuf as packets are consumed; it is moved back to
+     * the start of inbuf only when packet_room() needs the space.
+     */
+    unsigned char inbuf[MAX_PACKET_LENGTH*2+1];
+    unsigned char *inbuffer;
     size_t inbuflen;
     unsigned char *inbufptr;
-    /* outbuffer needs to be able to hold 4 GPGSV records at once */
-    unsigned char outbuffer[MAX_PACKET_LENGTH*2+1];
+    /*
+     * outbuffer points at the last packet, NUL-terminated in outbuf for
+     * textual types, in place in inbuf for binary ones.  Either way it
+     * is good until the next packet_get().
+     */
+    unsigned char *outbuffer;
     size_t outbuflen;
+    unsigned char *packet;		/* the last packet where it was read */
+    /* outbuf needs to be able to hold 4 GPGSV records at once */
+    unsigned char outbuf[MAX_PACKET_LENGTH*2+1];
     unsigned long char_counter;		/* count characters processed */
     unsigned long retry_counter;	/* count sniff retries */
     unsigned counter;			/* packets since last driver switch */
@@ -271,11 +284,25 @@ struct gps_lexer_t {
 #endif /* STASH_ENABLE */
 };
 
+/*
+ * A read-only view of the last packet, as a rule in place in the lexer's
+ * input, good until the next packet_get().  Drivers that only read a
+ * packet should take one of these; it is not NUL-terminated, so it needs
+ * no copy.
+ */
+struct packet_view_t {
+    int type;
+    const unsigned char *data;
+    size_t len;
+};
+
 extern void lexer_init(struct gps_lexer_t *);
 extern void packet_reset(struct gps_lexer_t *);
 extern void packet_pushback(struct gps_lexer_t *);
 extern void packet_parse(struct gps_lexer_t *);
 extern ssize_t packet_get(int, struct gps_lexer_t *);
+extern size_t packet_room(struct gps_lexer_t *);
+extern struct packet_view_t packet_view(const struct gps_lexer_t *);
 extern int packet_sniff(struct gps_lexer_t *);
 #define packet_buffered_input(lexer) ((lexer)->inbuffer + (lexer)->inbuflen - (lexer)->inbufptr)
 
@@ -292,6 +319,12 @@ extern int packet_sniff(struct gps_lexer_t *);
 #define NTPSHMSEGS	(MAX_DEVICES * 2)	/* number of NTP SHM segments */
 #define NTP_MIN_FIXES	3  /* # fixes to wait for before shipping NTP time */
 
+/* record classes of the per-device SHM export segments */
+#define SHM_FIX		0	/* fix, status and DOPs */
+#define SHM_SKY		1	/* skyview */
+#define SHM_RAW		2	/* raw measurements */
+#define SHM_CLASSES	3
+
 
 #define AIVDM_CHANNELS	2		/* A, B */
 
@@ -325,14 +358,20 @@ struct gps_context_t {
     volatile struct shmTime *shmTime[NTPSHMSEGS];
     bool shmTimeInuse[NTPSHMSEGS];
     void (*pps_hook)(struct gps_device_t *, struct timedelta_t *);
+    /* called just before a device's descriptor is closed */
+    void (*close_hook)(struct gps_device_t *);
 #ifdef SHM_EXPORT_ENABLE
     /* we don't want the compiler to treat writes to shmexport as dead code,
      * and we don't want them reordered either */
     volatile void *shmexport;
     int shmid;				/* ID of SHM  (for later IPC_RMID) */
 #endif
+    int udpfd;				/* UDP export socket, -1 if none */
     ssize_t (*serial_write)(struct gps_device_t *,
 			    const char *buf, const size_t len);
+    /* per-device limits for one gpsd_multipoll() call, 0 = no limit */
+    unsigned int poll_packets;		/* packets handled */
+    size_t poll_bytes;			/* packet bytes handled */
 };
 
 /* state for resolving interleaved Type 24 packets */
@@ -538,11 +577,17 @@ struct gps_device_t {
     time_t releasetime;
     bool zerokill;
     time_t reawake;
+    bool overbudget;		/* multipoll left input in the lexer buffer */
+    unsigned int udpseq;	/* next UDP export datagram number */
     timespec_t sor;	        /* time start of this reporting cycle */
     unsigned long chars;	/* characters in the cycle */
     bool ship_to_ntpd;
     volatile struct shmTime *shm_clock;
     volatile struct shmTime *shm_pps;
+#ifdef SHM_EXPORT_ENABLE
+    volatile struct shmdevice_t *shmdevice[SHM_CLASSES];	/* per class */
+    int shmdeviceid[SHM_CLASSES];
+#endif /* SHM_EXPORT_ENABLE */
     int chronyfd;			/* for talking to chrony */
     volatile struct pps_thread_t pps_thread;
     /*
@@ -841,7 +886,7 @@ extern void rtcm2_unpack(struct gps_device_t *, struct rtcm2_t *, char *);
 extern void json_rtcm3_dump(const struct rtcm3_t *,
 			    const char *, char[], size_t);
 extern void rtcm3_unpack(const struct gps_context_t *,
-			 struct rtcm3_t *, char *);
+			 struct rtcm3_t *, const char *);
 
 /* here are the available GPS drivers */
 extern const struct gps_type_t **gpsd_drivers;
@@ -851,6 +896,8 @@ extern gps_mask_t generic_parse_input(struct gps_device_t *);
 extern ssize_t generic_get(struct gps_device_t *);
 
 extern gps_mask_t nmea_parse(char *, struct gps_device_t *);
+extern gps_mask_t nmea_parse_view(const struct packet_view_t *,
+				  struct gps_device_t *);
 extern ssize_t nmea_write(struct gps_device_t *, char *, size_t);
 extern ssize_t nmea_send(struct gps_device_t *, const char *, ... );
 extern void nmea_add_checksum(char *);
@@ -955,16 +1002,86 @@ extern gps_mask_t ecef_to_wgs84fix(struct gps_fix_t *,
 extern void clear_dop(struct dop_t *);
 
 /* shmexport.c */
-#define GPSD_SHM_KEY	0x47505344	/* "GPSD" */
+/*
+ * "GPSD" keyed the single-update layout; readers built for that must not
+ * find these segments.  SHM_MAGIC opens every segment, so a reader can
+ * tell a layout it doesn't know from one it does, whatever the key.
+ */
+#define GPSD_SHM_KEY	0x47505345	/* "GPSE" */
+#define SHM_MAGIC	0x47505332	/* "GPS2", bump on any layout change */
+#define SHM_RING	16	/* updates a reader may fall behind by */
+/*
+ * Update n goes in slot n % SHM_RING.  Its seq is 2n - 1 while it is
+ * being written and 2n once it is whole; head is the newest whole one.
+ * Counters wrap, so compare them only by difference.  On Linux, readers
+ * with nothing to read sleep on head as a futex, counted in waiters.
+ */
 struct shmexport_t
 {
-    int bookend1;
-    struct gps_data_t gpsdata;
-    int bookend2;
+    unsigned int magic;
+    unsigned int head;
+    unsigned int waiters;
+    struct shmslot_t {
+	unsigned int seq;
+	struct gps_data_t gpsdata;
+    } slot[SHM_RING];
+};
+/*
+ * Each device slot also gets a segment per record class, keyed above
+ * the main one, so a reader can map just the class it wants from just
+ * the device it wants, and the daemon copies only what changed.  The
+ * rings work as in shmexport_t; slots are stride bytes apart after the
+ * header, each starting with a shmrecord_t.  An empty path means the
+ * device has gone and the segment will see no more updates.
+ */
+#define SHM_DEVICE_KEY(key, n, class)	((key) + 1 + (n) * SHM_CLASSES + (class))
+struct shmdevice_t
+{
+    unsigned int magic;
+    unsigned int head;
+    unsigned int waiters;
+    unsigned int class;
+    unsigned int stride;
+    char path[GPS_PATH_MAX];
+};
+struct shmrecord_t
+{
+    unsigned int seq;
+    gps_mask_t set;
+};
+struct shmfix_t
+{
+    struct shmrecord_t hdr;
+    int status;
+    struct gps_fix_t fix;
+    struct dop_t dop;
+};
+struct shmsky_t
+{
+    struct shmrecord_t hdr;
+    timespec_t skyview_time;
+    int satellites_visible;
+    int satellites_used;
+    struct dop_t dop;
+    struct satellite_t skyview[MAXCHANNELS];
+};
+struct shmraw_t
+{
+    struct shmrecord_t hdr;
+    struct rawdata_t raw;
 };
 extern bool shm_acquire(struct gps_context_t *);
 extern void shm_release(struct gps_context_t *);
 extern void shm_update(struct gps_context_t *, struct gps_data_t *);
+extern void shm_device_update(struct gps_context_t *, struct gps_device_t *,
+			      int, gps_mask_t);
+extern void shm_device_release(struct gps_context_t *, struct gps_device_t *);
+
+/* udpexport.c */
+extern bool udp_acquire(struct gps_context_t *, const char *);
+extern void udp_release(struct gps_context_t *);
+extern void udp_update(struct gps_context_t *, struct gps_device_t *,
+		       const char *, size_t);
 
 /* dbusexport.c */
 #if defined(DBUS_EXPORT_ENABLE)
@@ -1007,6 +1124,47 @@ extern int gpsd_await_data(fd_set *,
 			    const int,
 			    fd_set *,
 			    struct gpsd_errout_t *errout);
+
+/* eventloop.c */
+#define EVLOOP_READ	0x01	/* readable, or hung up */
+#define EVLOOP_WRITE	0x02	/* writable */
+#define EVLOOP_BADFD	0x04	/* returned only: descriptor went stale */
+#define EVLOOP_UNUSED	-1	/* tag of an unregistered descriptor */
+#define EVLOOP_MAXEVENTS	64	/* most events returned by one wait */
+struct evloop_watch_t {
+    unsigned int events;	/* EVLOOP_READ and/or EVLOOP_WRITE */
+    int tag;			/* caller's kind of descriptor */
+    void *data;			/* caller's pointer, e.g. device or client */
+    bool always;		/* regular file, select() says always ready */
+};
+struct evloop_event_t {
+    socket_t fd;
+    unsigned int events;	/* which EVLOOP_* conditions fired */
+    int tag;
+    void *data;
+};
+struct evloop_t {
+    int backend;		/* epoll descriptor, -1 for pselect() */
+    struct evloop_watch_t *watches;	/* indexed by descriptor */
+    int nwatches;		/* allocated length of watches[] */
+    int count;			/* registered descriptors */
+    int always;			/* registered regular files */
+    socket_t maxfd;		/* highest registered descriptor */
+    int wake[2];		/* pselect() only: wakeup pipe */
+    bool waiting;		/* pselect() only: in a wait */
+    struct gpsd_errout_t *errout;
+};
+extern bool gpsd_evloop_init(struct evloop_t *, struct gpsd_errout_t *);
+extern void gpsd_evloop_close(struct evloop_t *);
+extern bool gpsd_evloop_add(struct evloop_t *, socket_t, unsigned int,
+                            int, void *);
+extern bool gpsd_evloop_modify(struct evloop_t *, socket_t, unsigned int);
+extern void gpsd_evloop_remove(struct evloop_t *, socket_t);
+extern void gpsd_evloop_release(struct evloop_t *, socket_t, void *);
+extern bool gpsd_evloop_watched(const struct evloop_t *, socket_t);
+extern int gpsd_evloop_wait(struct evloop_t *, struct evloop_event_t *,
+                            int, const timespec_t *);
+
 extern gps_mask_t gpsd_poll(struct gps_device_t *);
 #define DEVICE_EOF	-3
 #define DEVICE_ERROR	-2
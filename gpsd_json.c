@@ -19,6 +19,7 @@ PERMISSIONS
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
+#include <stddef.h>       /* for offsetof() */
 #include <stdio.h>
 #include <stdlib.h>       // for qsort()
 #include <string.h>       /* for strcat(), strlcpy() */
@@ -517,12 +518,254 @@ void json_watch_dump(const struct gps_policy_t *ccp,
 		   ccp->timing ? "true" : "false",
 		   ccp->split24 ? "true" : "false",
 		   ccp->pps ? "true" : "false");
+    if (ccp->binary)
+	(void)strlcat(reply, "\"binary\":true,", replylen);
+    if (ccp->delta)
+	(void)strlcat(reply, "\"delta\":true,", replylen);
+    if ('\0' != ccp->fields[0]) {
+	const char *cp, *name = ccp->fields;
+
+	(void)strlcat(reply, "\"fields\":[", replylen);
+	do {
+	    cp = strchr(name, ',');
+	    str_appendf(reply, replylen, "\"%.*s\",",
+			(int)(NULL == cp ? strlen(name) : (size_t)(cp - name)),
+			name);
+	    name = cp + 1;
+	} while (NULL != cp);
+	str_rstrip_char(reply, ',');
+	(void)strlcat(reply, "],", replylen);
+    }
+    if (0 < ccp->interval)
+	str_appendf(reply, replylen, "\"interval\":%.3f,", ccp->interval);
+    if (0 < ccp->aisinterval)
+	str_appendf(reply, replylen, "\"aisinterval\":%.3f,",
+		    ccp->aisinterval);
+    if (ccp->compress)
+	(void)strlcat(reply, "\"compress\":true,", replylen);
     if (ccp->devpath[0] != '\0')
 	str_appendf(reply, replylen, "\"device\":\"%s\",", ccp->devpath);
     str_rstrip_char(reply, ',');
     (void)strlcat(reply, "}\r\n", replylen);
 }
 
+/*
+ * Delta reports.  A delta is a report cut down to its class, device
+ * and the members whose text differs from the same class's previous
+ * report, flagged by "delta":true after the class.  In an array of
+ * objects that kept its length, such as SKY's satellites, each element
+ * is cut down the same way, to {} if nothing in it changed.  A member
+ * that has gone away can't be expressed, so then the full report has
+ * to be sent instead.  These work on gpsd's own compact output only.
+ */
+
+static const char *json_skip_value(const char *cp)
+/* step over one JSON value, or a quoted name */
+{
+    int depth = 0;
+    bool quoted = false;
+
+    for (; '\0' != *cp; cp++) {
+	if (quoted) {
+	    if ('\\' == *cp && '\0' != cp[1])
+		cp++;
+	    else if ('"' == *cp) {
+		quoted = false;
+		if (0 == depth)
+		    return cp + 1;
+	    }
+	    continue;
+	}
+	switch (*cp) {
+	case '"':
+	    quoted = true;
+	    break;
+	case '{':
+	case '[':
+	    depth++;
+	    break;
+	case '}':
+	case ']':
+	    if (0 == depth)
+		return cp;
+	    if (0 == --depth)
+		return cp + 1;
+	    break;
+	case ',':
+	    if (0 == depth)
+		return cp;
+	    break;
+	}
+    }
+    return cp;
+}
+
+static const char *json_find_member(const char *obj, const char *name,
+				    size_t namelen, size_t *vlen)
+/* the value of the named member of obj, name in quotes; NULL if none */
+{
+    const char *cp = obj + 1;
+
+    while ('"' == *cp) {
+	const char *colon = json_skip_value(cp);
+	const char *end;
+
+	if (':' != *colon)
+	    break;
+	end = json_skip_value(colon + 1);
+	if ((size_t)(colon - cp) == namelen && 0 == memcmp(cp, name, namelen)) {
+	    *vlen = (size_t)(end - colon) - 1;
+	    return colon + 1;
+	}
+	if (',' != *end)
+	    break;
+	cp = end + 1;
+    }
+    return NULL;
+}
+
+static bool json_delta_members(const char *base, const char *report,
+			       bool top, char *out, size_t outlen)
+/* append report's members that differ from base's, each comma-ended */
+{
+    const char *cp = report + 1;
+    const char *bp;
+    int members = 0, matched = 0;
+
+    /* count base's members, to tell whether any went away */
+    for (bp = base + 1; '"' == *bp; members++) {
+	bp = json_skip_value(json_skip_value(bp) + 1);
+	if (',' == *bp)
+	    bp++;
+    }
+
+    while ('"' == *cp) {
+	const char *name = cp;
+	const char *value = json_skip_value(name) + 1;
+	const char *bvalue;
+	size_t namelen = (size_t)(value - name) - 1;
+	size_t vlen, bvlen, mlen;
+
+	if (':' != value[-1])
+	    return false;
+	cp = json_skip_value(value);
+	vlen = (size_t)(cp - value);
+	mlen = (size_t)(cp - name);	/* "name":value */
+	if (',' == *cp)
+	    cp++;
+
+	bvalue = json_find_member(base, name, namelen, &bvlen);
+	if (NULL != bvalue)
+	    matched++;
+	if (top && (str_starts_with(name, "\"class\":") ||
+		    str_starts_with(name, "\"device\":"))) {
+	    /* identification always goes, the flag right after the class */
+	    str_appendf(out, outlen, "%.*s,", (int)mlen, name);
+	    if (str_starts_with(name, "\"class\":"))
+		(void)strlcat(out, "\"delta\":true,", outlen);
+	    continue;
+	}
+	if (NULL != bvalue && vlen == bvlen && 0 == memcmp(value, bvalue, vlen))
+	    continue;		/* unchanged */
+	if (NULL != bvalue && str_starts_with(value, "[{") &&
+	    str_starts_with(bvalue, "[{")) {
+	    /* array of objects: element by element, if the count held */
+	    const char *ep = value + 1, *bep = bvalue + 1;
+
+	    str_appendf(out, outlen, "%.*s[", (int)(value - name), name);
+	    while ('{' == *ep && '{' == *bep) {
+		(void)strlcat(out, "{", outlen);
+		if (!json_delta_members(bep, ep, false, out, outlen))
+		    return false;
+		str_rstrip_char(out, ',');
+		(void)strlcat(out, "},", outlen);
+		ep = json_skip_value(ep);
+		bep = json_skip_value(bep);
+		if (',' == *ep)
+		    ep++;
+		if (',' == *bep)
+		    bep++;
+	    }
+	    if (*ep != *bep)
+		return false;	/* the array grew or shrank */
+	    str_rstrip_char(out, ',');
+	    (void)strlcat(out, "],", outlen);
+	    continue;
+	}
+	str_appendf(out, outlen, "%.*s,", (int)mlen, name);
+    }
+    return '}' == *cp && matched == members;
+}
+
+static bool json_field_wanted(const char *fields, const char *name,
+			      size_t namelen)
+/* is the quoted name one of the comma-separated fields? */
+{
+    const char *cp = fields;
+
+    name++;
+    namelen -= 2;
+    while ('\0' != *cp) {
+	size_t n = strcspn(cp, ",");
+
+	if (n == namelen && 0 == memcmp(cp, name, n))
+	    return true;
+	cp += n;
+	if (',' == *cp)
+	    cp++;
+    }
+    return false;
+}
+
+bool json_project(const char *fields, const char *report,
+		  char *out, size_t outlen)
+/* report cut down to the named members, besides class, device and any
+ * delta flag; false if it had none of them */
+{
+    const char *cp = report + 1;
+    bool any = false;
+
+    if ('{' != report[0])
+	return false;
+    (void)strlcpy(out, "{", outlen);
+    while ('"' == *cp) {
+	const char *name = cp;
+	const char *value = json_skip_value(name) + 1;
+
+	if (':' != value[-1])
+	    return false;
+	cp = json_skip_value(value);
+	if (str_starts_with(name, "\"class\":")
+	    || str_starts_with(name, "\"device\":")
+	    || str_starts_with(name, "\"delta\":"))
+	    str_appendf(out, outlen, "%.*s,", (int)(cp - name), name);
+	else if (json_field_wanted(fields, name, (size_t)(value - name) - 1)) {
+	    str_appendf(out, outlen, "%.*s,", (int)(cp - name), name);
+	    any = true;
+	}
+	if (',' == *cp)
+	    cp++;
+    }
+    str_rstrip_char(out, ',');
+    (void)strlcat(out, "}", outlen);
+    return any && strlen(out) + 1 < outlen;
+}
+
+bool json_delta(const char *base, const char *report,
+		char *out, size_t outlen)
+/* report as a delta against base; false if it needs sending whole */
+{
+    if ('{' != base[0] || '{' != report[0])
+	return false;
+    (void)strlcpy(out, "{", outlen);
+    if (!json_delta_members(base, report, true, out, outlen))
+	return false;
+    str_rstrip_char(out, ',');
+    (void)strlcat(out, "}", outlen);
+    /* a truncated delta would be worse than none */
+    return strlen(out) + 1 < outlen;
+}
+
 void json_subframe_dump(const struct gps_data_t *datap,
 			char buf[], size_t buflen)
 {
@@ -3842,7 +4085,9 @@ void json_data_report(const gps_mask_t changed,
 		 const struct gps_device_t *session,
 		 const struct gps_policy_t *policy,
 		 char *buf, size_t buflen)
-/* report a session state in JSON */
+/* report a session state in JSON.  Only policy->scaled and
+ * policy->timing may change the output; gpsd relies on that to
+ * share one encoding among its subscribers. */
 {
     const struct gps_data_t *datap = &session->gpsdata;
     buf[0] = '\0';
@@ -3902,6 +4147,168 @@ void json_data_report(const gps_mask_t changed,
 #endif /* OSCILLATOR_ENABLE */
 }
 
+static void binary_put_double(char *buf, size_t off, double d)
+{
+    uint64_t u;
+
+    memcpy(&u, &d, sizeof(u));
+    putle32(buf, off, (uint32_t)u);
+    putle32(buf, off + 4, (uint32_t)(u >> 32));
+}
+
+static void binary_put_float(char *buf, size_t off, double d)
+{
+    float f = (float)d;
+    uint32_t u;
+
+    memcpy(&u, &f, sizeof(u));
+    putle32(buf, off, u);
+}
+
+static void binary_put_time(char *buf, size_t off, timespec_t ts)
+{
+    putle32(buf, off, (uint32_t)ts.tv_sec);
+    putle32(buf, off + 4, (uint32_t)((int64_t)ts.tv_sec >> 32));
+    putle32(buf, off + 8, (uint32_t)ts.tv_nsec);
+}
+
+static size_t binary_record(char *buf, size_t buflen, int type,
+			    const char *path, size_t bodylen)
+/* write a record header; returns the body offset, 0 if it won't fit */
+{
+    size_t pathlen = strnlen(path, 255);
+
+    if (pathlen + 5 + bodylen > buflen || 0xffff < bodylen)
+	return 0;
+    putbyte(buf, 0, BINARY_MAGIC);
+    putbyte(buf, 1, type);
+    putbyte(buf, 2, pathlen);
+    memcpy(buf + 3, path, pathlen);
+    putle16(buf, pathlen + 3, bodylen);
+    return pathlen + 5;
+}
+
+static size_t binary_tpv_dump(const struct gps_device_t *session,
+			      char *buf, size_t buflen)
+{
+    const struct gps_data_t *gpsdata = &session->gpsdata;
+    const char *fix = (const char *)&gpsdata->fix;
+    char body[26 + BINARY_TPV_FIELDS * 8 + 1 + sizeof(gpsdata->fix.datum)];
+    uint64_t present = 0;
+    size_t i, len = 26, off;
+
+    putbyte(body, 0, gpsdata->status);
+    putbyte(body, 1, gpsdata->fix.mode);
+    if (LEAP_SECOND_VALID == (session->context->valid & LEAP_SECOND_VALID))
+	putle16(body, 2, session->context->leap_seconds);
+    else
+	putle16(body, 2, 0);
+    putle16(body, 4, gpsdata->fix.dgps_station);
+    binary_put_time(body, 6, gpsdata->fix.time);
+    for (i = 0; i < BINARY_TPV_FIELDS; i++) {
+	double d;
+
+	if (gpsdata->fix.mode < binary_tpv_fields[i].mode)
+	    continue;
+	memcpy(&d, fix + binary_tpv_fields[i].offset, sizeof(d));
+	if (0 == isfinite(d))
+	    continue;
+	/* dgpsAge and dgpsSta come together, or not at all */
+	if (offsetof(struct gps_fix_t, dgps_age) == binary_tpv_fields[i].offset
+	    && 0 > gpsdata->fix.dgps_station)
+	    continue;
+	present |= (uint64_t)1 << i;
+	binary_put_double(body, len, d);
+	len += 8;
+    }
+    putle32(body, 18, (uint32_t)present);
+    putle32(body, 22, (uint32_t)(present >> 32));
+    i = strnlen(gpsdata->fix.datum, sizeof(gpsdata->fix.datum) - 1);
+    putbyte(body, len, i);
+    memcpy(body + len + 1, gpsdata->fix.datum, i);
+    len += i + 1;
+
+    off = binary_record(buf, buflen, BINARY_TPV, gpsdata->dev.path, len);
+    if (0 == off)
+	return 0;
+    memcpy(buf + off, body, len);
+    return off + len;
+}
+
+static size_t binary_sky_dump(const struct gps_data_t *datap,
+			      char *buf, size_t buflen)
+{
+    const double dops[] = {
+	datap->dop.xdop, datap->dop.ydop, datap->dop.vdop, datap->dop.tdop,
+	datap->dop.hdop, datap->dop.gdop, datap->dop.pdop,
+    };
+    size_t i, len, off, nsat = 0;
+    unsigned int present = 0;
+    char *body;
+
+    for (i = 0; i < (size_t)datap->satellites_visible; i++)
+	if (datap->skyview[i].PRN)
+	    nsat++;
+    len = 13 + (size_t)NITEMS(dops) * 8 + 2 + nsat * 20;
+    off = binary_record(buf, buflen, BINARY_SKY, datap->dev.path, len);
+    if (0 == off)
+	return 0;
+    body = buf + off;
+
+    binary_put_time(body, 0, datap->skyview_time);
+    len = 13;
+    for (i = 0; i < (size_t)NITEMS(dops); i++)
+	if (0 != isfinite(dops[i])) {
+	    present |= 1U << i;
+	    binary_put_double(body, len, dops[i]);
+	    len += 8;
+	}
+    putbyte(body, 12, present);
+    putle16(body, len, nsat);
+    len += 2;
+    for (i = 0; i < (size_t)datap->satellites_visible; i++) {
+	const struct satellite_t *sp = &datap->skyview[i];
+
+	if (0 == sp->PRN)
+	    continue;
+	putle16(body, len, sp->PRN);
+	putbyte(body, len + 2, sp->gnssid);
+	putbyte(body, len + 3, sp->svid);
+	putbyte(body, len + 4, sp->sigid);
+	/* as in json_sky_dump(), only GLONASS has a frequency slot */
+	if (GNSSID_GLO == sp->gnssid && 0 <= sp->freqid && 16 >= sp->freqid)
+	    putbyte(body, len + 5, sp->freqid);
+	else
+	    putbyte(body, len + 5, -1);
+	putbyte(body, len + 6, sp->health);
+	putbyte(body, len + 7, sp->used);
+	binary_put_float(body, len + 8,
+			 90 >= fabs(sp->elevation) ? sp->elevation : NAN);
+	binary_put_float(body, len + 12,
+			 359 >= fabs(sp->azimuth) ? sp->azimuth : NAN);
+	binary_put_float(body, len + 16, sp->ss);
+	len += 20;
+    }
+    /* the length in the header counted the dops as all present */
+    putle16(buf, off - 2, len);
+    return off + len;
+}
+
+size_t binary_data_report(const gps_mask_t changed,
+			  const struct gps_device_t *session,
+			  char *buf, size_t buflen)
+/* report TPV and SKY as binary records; returns the bytes written.
+ * The caller sends anything else in changed as JSON. */
+{
+    size_t len = 0;
+
+    if ((changed & REPORT_IS) != 0)
+	len += binary_tpv_dump(session, buf, buflen);
+    if ((changed & SATELLITE_SET) != 0)
+	len += binary_sky_dump(&session->gpsdata, buf + len, buflen - len);
+    return len;
+}
+
 #undef JSON_BOOL
 #endif /* SOCKET_EXPORT_ENABLE */
 
@@ -80,6 +80,7 @@ newLexerObject(PyObject *arg UNUSED)
     if (self == NULL)
 	return NULL;
     memset(&self->lexer, 0, sizeof(struct gps_lexer_t));
+    self->lexer.packet = self->lexer.outbuffer = self->lexer.outbuf;
     packet_reset(&self->lexer);
     return self;
 }
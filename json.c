@@ -281,9 +281,11 @@ static int json_internal_read_object(const char *cp,
 		pattr = attrbuf;
 		if (end != NULL)
 		    *end = cp;
-	    } else if (*cp == '}')
-		break;
-	    else {
+	    } else if (*cp == '}') {
+		/* an empty object */
+		++cp;
+		goto good_parse;
+	    } else {
 		json_debug_trace((1, "Non-WS when expecting attribute.\n"));
 		if (end != NULL)
 		    *end = cp;
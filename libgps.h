@@ -27,7 +27,11 @@ extern int gps_sock_stream(struct gps_data_t *, unsigned int, void *);
 extern const char *gps_sock_data(const struct gps_data_t *);
 extern int gps_sock_mainloop(struct gps_data_t *, int,
 			      void (*)(struct gps_data_t *));
+extern int gps_udp_open(const char *, const char *, struct gps_data_t *);
+extern int gps_local_open(const char *, struct gps_data_t *);
 extern int gps_shm_open(struct gps_data_t *);
+extern int gps_shm_device_open(const char *, const char *,
+			       struct gps_data_t *);
 extern void gps_shm_close(struct gps_data_t *);
 extern bool gps_shm_waiting(const struct gps_data_t *, int);
 extern int gps_shm_read(struct gps_data_t *);
@@ -16,6 +16,9 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdarg.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>       /* for SOCK_SEQPACKET */
+#endif /* HAVE_SYS_SOCKET_H */
 
 #include "gpsd.h"
 #include "libgps.h"
@@ -58,11 +61,11 @@ void gps_enable_debug(int level UNUSED, FILE * fp UNUSED) {}
 void libgps_trace(int errlevel UNUSED, const char *fmt UNUSED, ...){}
 #endif /* LIBGPS_DEBUG */
 
-#ifdef SOCKET_EXPORT_ENABLE
+#if defined(SOCKET_EXPORT_ENABLE) || defined(SHM_EXPORT_ENABLE)
 #define CONDITIONALLY_UNUSED
 #else
 #define CONDITIONALLY_UNUSED UNUSED
-#endif /* SOCKET_EXPORT_ENABLE */
+#endif /* SOCKET_EXPORT_ENABLE || SHM_EXPORT_ENABLE */
 
 int gps_open(const char *host,
 	     const char *port CONDITIONALLY_UNUSED,
@@ -80,6 +83,18 @@ int gps_open(const char *host,
 	    status = SHM_NOSHARED;
 	else if (status == -2)
 	    status = SHM_NOATTACH;
+	else if (status == -3)
+	    status = SHM_BADLAYOUT;
+    }
+    if (host != NULL && str_starts_with(host, GPSD_SHM_DEVICE)) {
+	status = gps_shm_device_open(host + strlen(GPSD_SHM_DEVICE),
+				     port, gpsdata);
+	if (status == -1)
+	    status = SHM_NOSHARED;
+	else if (status == -2)
+	    status = SHM_NOATTACH;
+	else if (status == -3)
+	    status = SHM_BADLAYOUT;
     }
 #define USES_HOST
 #endif /* SHM_EXPORT_ENABLE */
@@ -93,6 +108,26 @@ int gps_open(const char *host,
 #define USES_HOST
 #endif /* DBUS_EXPORT_ENABLE */
 
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) && \
+    !defined(USE_QT)
+    if (host != NULL && str_starts_with(host, GPSD_UDP_EXPORT)) {
+	status = gps_udp_open(host + strlen(GPSD_UDP_EXPORT), port, gpsdata);
+	if (status == -1)
+	    return -1;
+    }
+#define USES_HOST
+#endif /* UDP_EXPORT_ENABLE && SOCKET_EXPORT_ENABLE && !USE_QT */
+
+#if defined(SOCKET_EXPORT_ENABLE) && defined(SOCK_SEQPACKET) && \
+    !defined(USE_QT)
+    if (host != NULL && str_starts_with(host, GPSD_LOCAL_SOCKET)) {
+	status = gps_local_open(host + strlen(GPSD_LOCAL_SOCKET), gpsdata);
+	if (status == -1)
+	    return -1;
+    }
+#define USES_HOST
+#endif /* SOCKET_EXPORT_ENABLE && SOCK_SEQPACKET && !USE_QT */
+
 #ifdef SOCKET_EXPORT_ENABLE
     if (status == -1) {
         status = gps_sock_open(host, port, gpsdata);
@@ -289,6 +324,8 @@ extern const char *gps_errstr(const int err)
 	return "no shared-memory segment or daemon not running";
     else if (err == SHM_NOATTACH)
 	return "attach failed for unknown reason";
+    else if (err == SHM_BADLAYOUT)
+	return "shared-memory segment from an incompatible gpsd";
 #endif /* SHM_EXPORT_ENABLE */
 #ifdef DBUS_EXPORT_ENABLE
     if (err == DBUS_FAILURE)
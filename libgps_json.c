@@ -27,17 +27,33 @@ PERMISSIONS
 #include <string.h>
 
 #include "gpsd.h"
+#include "bits.h"
 #include "strfuncs.h"
 #ifdef SOCKET_EXPORT_ENABLE
 #include "gps_json.h"
 #include "timespec.h"
 
+static bool json_is_delta(const char *buf)
+/* is this a delta report?  gpsd flags it right after the class */
+{
+    const char *cp = strchr(buf, ',');
+
+    return NULL != cp && str_starts_with(cp + 1, "\"delta\":true");
+}
+
+static void json_nodefaults(struct json_attr_t *attrs)
+/* have json_read_object() leave absent members as they were */
+{
+    for (; NULL != attrs->attribute; attrs++)
+        attrs->nodefault = true;
+}
+
 static int json_tpv_read(const char *buf, struct gps_data_t *gpsdata,
                          const char **endptr)
 {
     int ret;
 
-    const struct json_attr_t json_attrs_1[] = {
+    struct json_attr_t json_attrs_1[] = {
         /* *INDENT-OFF* */
         {"class",  t_check,   .dflt.check = "TPV"},
         {"device", t_string,  .addr.string = gpsdata->dev.path,
@@ -133,6 +149,9 @@ static int json_tpv_read(const char *buf, struct gps_data_t *gpsdata,
         /* *INDENT-ON* */
     };
 
+    /* a delta holds what changed, merge it into the previous TPV */
+    if (json_is_delta(buf))
+        json_nodefaults(json_attrs_1);
     ret = json_read_object(buf, json_attrs_1, endptr);
     return ret;
 }
@@ -241,7 +260,7 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
                          const char **endptr)
 {
 
-    const struct json_attr_t json_attrs_satellites[] = {
+    struct json_attr_t json_attrs_satellites[] = {
         /* *INDENT-OFF* */
         {"PRN",    t_short,   STRUCTOBJECT(struct satellite_t, PRN)},
         {"el",     t_real,    STRUCTOBJECT(struct satellite_t, elevation),
@@ -261,9 +280,10 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
         /* *INDENT-ON* */
         {NULL},
     };
-    const struct json_attr_t json_attrs_2[] = {
+    struct json_attr_t json_attrs_2[] = {
         /* *INDENT-OFF* */
         {"class",      t_check,   .dflt.check = "SKY"},
+        {"delta",      t_ignore},
         {"device",     t_string,  .addr.string  = gpsdata->dev.path,
                                      .len = sizeof(gpsdata->dev.path)},
         {"time",       t_time,    .addr.ts = &gpsdata->skyview_time,
@@ -291,7 +311,16 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
     };
     int status, i;
 
-    memset(&gpsdata->skyview, 0, sizeof(gpsdata->skyview));
+    /*
+     * A delta holds what changed, merge it into the previous SKY.  Its
+     * satellites line up with the previous ones, those without changes
+     * being empty objects.
+     */
+    if (json_is_delta(buf)) {
+        json_nodefaults(json_attrs_2);
+        json_nodefaults(json_attrs_satellites);
+    } else
+        memset(&gpsdata->skyview, 0, sizeof(gpsdata->skyview));
 
     status = json_read_object(buf, json_attrs_2, endptr);
     if (status != 0)
@@ -584,6 +613,47 @@ int json_oscillator_read(const char *buf, struct gps_data_t *gpsdata,
 #define PASS(n) (((n) == 0) || ((n) == JSON_ERR_BADATTR))
 #define FILTER(n) ((n) == JSON_ERR_BADATTR ? 0 : n)
 
+static gps_mask_t tpv_mask(const struct gps_fix_t *fix)
+/* which parts of gps_data_t a TPV report set */
+{
+    gps_mask_t set = STATUS_SET;
+
+    if (0 != fix->time.tv_sec)
+        set |= TIME_SET;
+    if (isfinite(fix->ept) != 0)
+        set |= TIMERR_SET;
+    if (isfinite(fix->longitude) != 0)
+        set |= LATLON_SET;
+    if (0 != isfinite(fix->altitude) ||
+        0 != isfinite(fix->altHAE) ||
+        0 != isfinite(fix->depth) ||
+        0 != isfinite(fix->altMSL)) {
+        set |= ALTITUDE_SET;
+    }
+    if (isfinite(fix->epx) != 0 && isfinite(fix->epy) != 0)
+        set |= HERR_SET;
+    if (isfinite(fix->epv) != 0)
+        set |= VERR_SET;
+    if (isfinite(fix->track) != 0)
+        set |= TRACK_SET;
+    if (0 != isfinite(fix->magnetic_track) ||
+        0 != isfinite(fix->magnetic_var))
+        set |= MAGNETIC_TRACK_SET;
+    if (isfinite(fix->speed) != 0)
+        set |= SPEED_SET;
+    if (isfinite(fix->climb) != 0)
+        set |= CLIMB_SET;
+    if (isfinite(fix->epd) != 0)
+        set |= TRACKERR_SET;
+    if (isfinite(fix->eps) != 0)
+        set |= SPEEDERR_SET;
+    if (isfinite(fix->epc) != 0)
+        set |= CLIMBERR_SET;
+    if (fix->mode != MODE_NOT_SEEN)
+        set |= MODE_SET;
+    return set;
+}
+
 int libgps_json_unpack(const char *buf,
                        struct gps_data_t *gpsdata, const char **end)
 /* the only entry point - unpack a JSON object into gpsdata_t substructures */
@@ -595,40 +665,7 @@ int libgps_json_unpack(const char *buf,
         return -1;
     if (str_starts_with(classtag, "\"class\":\"TPV\"")) {
         status = json_tpv_read(buf, gpsdata, end);
-        gpsdata->set = STATUS_SET;
-        if (0 != gpsdata->fix.time.tv_sec)
-            gpsdata->set |= TIME_SET;
-        if (isfinite(gpsdata->fix.ept) != 0)
-            gpsdata->set |= TIMERR_SET;
-        if (isfinite(gpsdata->fix.longitude) != 0)
-            gpsdata->set |= LATLON_SET;
-        if (0 != isfinite(gpsdata->fix.altitude) ||
-            0 != isfinite(gpsdata->fix.altHAE) ||
-            0 != isfinite(gpsdata->fix.depth) ||
-            0 != isfinite(gpsdata->fix.altMSL)) {
-            gpsdata->set |= ALTITUDE_SET;
-        }
-        if (isfinite(gpsdata->fix.epx) != 0 && isfinite(gpsdata->fix.epy) != 0)
-            gpsdata->set |= HERR_SET;
-        if (isfinite(gpsdata->fix.epv) != 0)
-            gpsdata->set |= VERR_SET;
-        if (isfinite(gpsdata->fix.track) != 0)
-            gpsdata->set |= TRACK_SET;
-        if (0 != isfinite(gpsdata->fix.magnetic_track) ||
-            0 != isfinite(gpsdata->fix.magnetic_var))
-            gpsdata->set |= MAGNETIC_TRACK_SET;
-        if (isfinite(gpsdata->fix.speed) != 0)
-            gpsdata->set |= SPEED_SET;
-        if (isfinite(gpsdata->fix.climb) != 0)
-            gpsdata->set |= CLIMB_SET;
-        if (isfinite(gpsdata->fix.epd) != 0)
-            gpsdata->set |= TRACKERR_SET;
-        if (isfinite(gpsdata->fix.eps) != 0)
-            gpsdata->set |= SPEEDERR_SET;
-        if (isfinite(gpsdata->fix.epc) != 0)
-            gpsdata->set |= CLIMBERR_SET;
-        if (gpsdata->fix.mode != MODE_NOT_SEEN)
-            gpsdata->set |= MODE_SET;
+        gpsdata->set = tpv_mask(&gpsdata->fix);
         return FILTER(status);
     } else if (str_starts_with(classtag, "\"class\":\"GST\"")) {
         status = json_noise_read(buf, gpsdata, end);
@@ -747,6 +784,138 @@ int libgps_json_unpack(const char *buf,
         return -1;
 }
 
+static void binary_get_time(const char *buf, int off, timespec_t *ts)
+{
+    ts->tv_sec = (time_t)getles64(buf, off);
+    ts->tv_nsec = (long)getleu32(buf, off + 8);
+}
+
+static int binary_tpv_read(const char *body, size_t len,
+                           struct gps_data_t *gpsdata)
+{
+    char *fix = (char *)&gpsdata->fix;
+    uint64_t present;
+    size_t i, off = 26;
+
+    if (off > len)
+        return -1;
+    gps_clear_fix(&gpsdata->fix);
+    gpsdata->status = getub(body, 0);
+    gpsdata->fix.mode = getub(body, 1);
+    gpsdata->leap_seconds = getles16(body, 2);
+    gpsdata->fix.dgps_station = getles16(body, 4);
+    binary_get_time(body, 6, &gpsdata->fix.time);
+    present = getleu64(body, 18);
+    for (i = 0; i < BINARY_TPV_FIELDS; i++) {
+        double d;
+
+        if (0 == (present & ((uint64_t)1 << i)))
+            continue;
+        if (off + 8 > len)
+            return -1;
+        d = getled64(body, (int)off);
+        memcpy(fix + binary_tpv_fields[i].offset, &d, sizeof(d));
+        off += 8;
+    }
+    if (off >= len || off + 1 + getub(body, off) > len ||
+        getub(body, off) >= sizeof(gpsdata->fix.datum))
+        return -1;
+    memcpy(gpsdata->fix.datum, body + off + 1, getub(body, off));
+    gpsdata->fix.datum[getub(body, off)] = '\0';
+    /* what a JSON client gets as the deprecated "alt" */
+    gpsdata->fix.altitude = (0 != isfinite(gpsdata->fix.altMSL)) ?
+        gpsdata->fix.altMSL : gpsdata->fix.altHAE;
+    return 0;
+}
+
+static int binary_sky_read(const char *body, size_t len,
+                           struct gps_data_t *gpsdata)
+{
+    double *dops[] = {
+        &gpsdata->dop.xdop, &gpsdata->dop.ydop, &gpsdata->dop.vdop,
+        &gpsdata->dop.tdop, &gpsdata->dop.hdop, &gpsdata->dop.gdop,
+        &gpsdata->dop.pdop,
+    };
+    size_t i, off = 13, nsat;
+    unsigned int present;
+
+    if (off > len)
+        return -1;
+    binary_get_time(body, 0, &gpsdata->skyview_time);
+    present = getub(body, 12);
+    for (i = 0; i < (size_t)NITEMS(dops); i++) {
+        if (0 == (present & (1U << i))) {
+            *dops[i] = NAN;
+            continue;
+        }
+        if (off + 8 > len)
+            return -1;
+        *dops[i] = getled64(body, (int)off);
+        off += 8;
+    }
+    if (off + 2 > len)
+        return -1;
+    nsat = getleu16(body, off);
+    off += 2;
+    if (MAXCHANNELS < nsat || off + nsat * 20 > len)
+        return -1;
+
+    memset(&gpsdata->skyview, 0, sizeof(gpsdata->skyview));
+    gpsdata->satellites_used = 0;
+    gpsdata->satellites_visible = (int)nsat;
+    for (i = 0; i < nsat; i++, off += 20) {
+        struct satellite_t *sp = &gpsdata->skyview[i];
+
+        sp->PRN = getles16(body, off);
+        sp->gnssid = getub(body, off + 2);
+        sp->svid = getub(body, off + 3);
+        sp->sigid = getub(body, off + 4);
+        sp->freqid = getsb(body, off + 5);
+        sp->health = getub(body, off + 6);
+        sp->used = 0 != getub(body, off + 7);
+        sp->elevation = getlef32(body, (int)off + 8);
+        sp->azimuth = getlef32(body, (int)off + 12);
+        sp->ss = getlef32(body, (int)off + 16);
+        if (sp->used)
+            gpsdata->satellites_used++;
+    }
+    return 0;
+}
+
+int libgps_binary_unpack(const char *buf, size_t len,
+                         struct gps_data_t *gpsdata)
+/* unpack one complete binary record into gpsdata_t substructures */
+{
+    size_t pathlen, bodylen;
+    const char *body;
+
+    if (5 > len || BINARY_MAGIC != getub(buf, 0))
+        return -1;
+    pathlen = getub(buf, 2);
+    if (pathlen + 5 > len || pathlen >= sizeof(gpsdata->dev.path))
+        return -1;
+    bodylen = getleu16(buf, pathlen + 3);
+    if (pathlen + 5 + bodylen > len)
+        return -1;
+    body = buf + pathlen + 5;
+    memcpy(gpsdata->dev.path, buf + 3, pathlen);
+    gpsdata->dev.path[pathlen] = '\0';
+
+    switch (buf[1]) {
+    case BINARY_TPV:
+        if (0 != binary_tpv_read(body, bodylen, gpsdata))
+            return -1;
+        gpsdata->set = tpv_mask(&gpsdata->fix);
+        return 0;
+    case BINARY_SKY:
+        if (0 != binary_sky_read(body, bodylen, gpsdata))
+            return -1;
+        gpsdata->set |= SATELLITE_SET;
+        return 0;
+    default:
+        return -1;
+    }
+}
 
 #endif /* SOCKET_EXPORT_ENABLE */
 
@@ -9,6 +9,9 @@ won't be able to filter by device, and won't get device activation/deactivation
 notifications.  But both client and daemon will avoid all the marshalling and
 unmarshalling overhead.
 
+   gps_shm_device_open() instead attaches to one record class of one
+device, and gps_shm_read() then fills in just that part of gps_data_t.
+
 PERMISSIONS
    This file is Copyright (c) 2010-2018 by the GPSD project
    SPDX-License-Identifier: BSD-2-clause
@@ -26,6 +29,11 @@ PERMISSIONS
 #include <sys/time.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
 
 #include "gpsd.h"
 #include "libgps.h"
@@ -33,7 +41,11 @@ PERMISSIONS
 struct privdata_t
 {
     void *shmseg;
-    int tick;
+    volatile unsigned int *head;	/* of the ring we read */
+    volatile unsigned int *waiters;
+    volatile struct shmdevice_t *device;	/* NULL for the main ring */
+    unsigned int next;		/* the update to read next */
+    unsigned long lost;		/* updates overwritten before we read them */
 };
 
 
@@ -47,7 +59,7 @@ int gps_shm_open(struct gps_data_t *gpsdata)
     libgps_debug_trace((DEBUG_CALLS, "gps_shm_open()\n"));
 
     gpsdata->privdata = NULL;
-    shmid = shmget((key_t)shmkey, sizeof(struct gps_data_t), 0);
+    shmid = shmget((key_t)shmkey, sizeof(struct shmexport_t), 0);
     if (shmid == -1) {
 	/* daemon isn't running or failed to create shared segment */
 	return -1;
@@ -56,7 +68,8 @@ int gps_shm_open(struct gps_data_t *gpsdata)
     if (gpsdata->privdata == NULL)
 	return -1;
 
-    PRIVATE(gpsdata)->tick = 0;
+    PRIVATE(gpsdata)->lost = 0;
+    PRIVATE(gpsdata)->device = NULL;
     PRIVATE(gpsdata)->shmseg = shmat(shmid, 0, 0);
     if (PRIVATE(gpsdata)->shmseg == (void *) -1) {
 	/* attach failed for sume unknown reason */
@@ -64,6 +77,23 @@ int gps_shm_open(struct gps_data_t *gpsdata)
 	gpsdata->privdata = NULL;
 	return -2;
     }
+    if (SHM_MAGIC !=
+	((volatile struct shmexport_t *)PRIVATE(gpsdata)->shmseg)->magic) {
+	/* a daemon with another layout, or one not done setting up */
+	(void)shmdt(PRIVATE(gpsdata)->shmseg);
+	free(gpsdata->privdata);
+	gpsdata->privdata = NULL;
+	return -3;
+    }
+    PRIVATE(gpsdata)->head =
+	&((volatile struct shmexport_t *)PRIVATE(gpsdata)->shmseg)->head;
+    PRIVATE(gpsdata)->waiters =
+	&((volatile struct shmexport_t *)PRIVATE(gpsdata)->shmseg)->waiters;
+    /* start with the newest update, if there is one yet */
+    PRIVATE(gpsdata)->next =
+	((volatile struct shmexport_t *)PRIVATE(gpsdata)->shmseg)->head;
+    if (0 == PRIVATE(gpsdata)->next)
+	PRIVATE(gpsdata)->next = 1;
 #ifndef USE_QT
     gpsdata->gps_fd = SHM_PSEUDO_FD;
 #else
@@ -72,12 +102,86 @@ int gps_shm_open(struct gps_data_t *gpsdata)
     return 0;
 }
 
+int gps_shm_device_open(const char *class, const char *device,
+			struct gps_data_t *gpsdata)
+/* attach to one record class of a device, or of the first device if NULL */
+{
+    static const char *classes[SHM_CLASSES] = {
+	[SHM_FIX] = "fix",
+	[SHM_SKY] = "sky",
+	[SHM_RAW] = "raw",
+    };
+    long shmkey = getenv("GPSD_SHM_KEY") ? strtol(getenv("GPSD_SHM_KEY"), NULL, 0) : GPSD_SHM_KEY;
+    int c, n;
+
+    libgps_debug_trace((DEBUG_CALLS, "gps_shm_device_open(%s, %s)\n",
+			class, device ? device : "any"));
+
+    gpsdata->privdata = NULL;
+    for (c = 0; c < SHM_CLASSES; c++)
+	if (0 == strcmp(class, classes[c]))
+	    break;
+    if (SHM_CLASSES == c)
+	return -1;
+
+    /* the daemon keys a device's segments by its slot; look in each */
+    for (n = 0; n < MAX_DEVICES; n++) {
+	volatile struct shmdevice_t *shared;
+	int shmid = shmget((key_t)SHM_DEVICE_KEY(shmkey, n, c), 0, 0);
+
+	if (-1 == shmid)
+	    continue;
+	shared = (volatile struct shmdevice_t *)shmat(shmid, 0, 0);
+	if ((void *)shared == (void *)-1)
+	    return -2;
+	if (SHM_MAGIC != shared->magic) {
+	    (void)shmdt((const void *)shared);
+	    return -3;
+	}
+	if ('\0' == shared->path[0]
+	    || (NULL != device && 0 != strcmp(device, (char *)shared->path))) {
+	    (void)shmdt((const void *)shared);
+	    continue;
+	}
+
+	gpsdata->privdata = (void *)malloc(sizeof(struct privdata_t));
+	if (gpsdata->privdata == NULL) {
+	    (void)shmdt((const void *)shared);
+	    return -1;
+	}
+	PRIVATE(gpsdata)->shmseg = (void *)shared;
+	PRIVATE(gpsdata)->device = shared;
+	PRIVATE(gpsdata)->head = &shared->head;
+	PRIVATE(gpsdata)->waiters = &shared->waiters;
+	PRIVATE(gpsdata)->lost = 0;
+	PRIVATE(gpsdata)->next = shared->head;
+	if (0 == PRIVATE(gpsdata)->next)
+	    PRIVATE(gpsdata)->next = 1;
+	(void)strlcpy(gpsdata->dev.path, (char *)shared->path,
+		      sizeof(gpsdata->dev.path));
+#ifndef USE_QT
+	gpsdata->gps_fd = SHM_PSEUDO_FD;
+#else
+	gpsdata->gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
+#endif /* USE_QT */
+	return 0;
+    }
+    /* daemon isn't running, or has no such device or records yet */
+    return -1;
+}
+
+static bool shm_gone(const struct gps_data_t *gpsdata)
+/* has the device we read gone away? */
+{
+    return NULL != PRIVATE(gpsdata)->device
+	   && '\0' == PRIVATE(gpsdata)->device->path[0];
+}
+
 /* check to see if new data has been written */
 /* timeout is in uSec */
 bool gps_shm_waiting(const struct gps_data_t *gpsdata, int timeout)
 {
-    volatile struct shmexport_t *shared =
-            (struct shmexport_t *)PRIVATE(gpsdata)->shmseg;
+    volatile unsigned int *headp = PRIVATE(gpsdata)->head;
     volatile bool newdata = false;
     timespec_t endtime;
 
@@ -86,17 +190,40 @@ bool gps_shm_waiting(const struct gps_data_t *gpsdata, int timeout)
     endtime.tv_nsec += (timeout % 1000000) * 1000;
     TS_NORM(&endtime);
 
+#ifdef __linux__
+    /* sleep on head until shm_update() moves it and wakes us */
+    for (;;) {
+	timespec_t now, left;
+	unsigned int head;
+	bool expired = false;
+
+	(void)__sync_fetch_and_add(PRIVATE(gpsdata)->waiters, 1);
+	head = *headp;
+	/* head is only moved once its update is whole */
+	if (0 <= (int)(head - PRIVATE(gpsdata)->next) || shm_gone(gpsdata))
+	    newdata = true;		/* a gone device is for read to report */
+	else {
+	    (void)clock_gettime(CLOCK_REALTIME, &now);
+	    if (TS_GT(&endtime, &now)) {
+		TS_SUB(&left, &endtime, &now);
+		/* returns at once if head has moved since we looked */
+		(void)syscall(SYS_futex, (unsigned int *)headp,
+			      FUTEX_WAIT, head, &left, NULL, 0);
+	    } else
+		expired = true;
+	}
+	(void)__sync_fetch_and_sub(PRIVATE(gpsdata)->waiters, 1);
+	if (newdata || expired)
+	    break;
+    }
+#else
     /* busy-waiting sucks, but there's not really an alternative */
     for (;;) {
-	volatile int bookend1, bookend2;
 	timespec_t now;
 
 	memory_barrier();
-	bookend1 = shared->bookend1;
-	memory_barrier();
-	bookend2 = shared->bookend2;
-	memory_barrier();
-	if (bookend1 == bookend2 && bookend1 > PRIVATE(gpsdata)->tick) {
+	/* head is only moved once its update is whole */
+	if (0 <= (int)(*headp - PRIVATE(gpsdata)->next) || shm_gone(gpsdata)) {
 	    newdata = true;
             break;
         }
@@ -105,44 +232,143 @@ bool gps_shm_waiting(const struct gps_data_t *gpsdata, int timeout)
 	    break;
         }
     }
+#endif /* __linux__ */
 
     return newdata;
 }
 
+static unsigned int shm_catch_up(struct gps_data_t *gpsdata,
+				 unsigned int head)
+/* the update to read next, skipping any the writer has lapped */
+{
+    unsigned int next = PRIVATE(gpsdata)->next;
+
+    if (head - next >= SHM_RING) {
+	/* overrun: skip to the oldest update still in the ring */
+	PRIVATE(gpsdata)->lost += head - next - (SHM_RING - 1);
+	libgps_debug_trace((DEBUG_CALLS,
+			   "gps_shm_read(): lost %u updates, "
+			   "%lu in all\n",
+			   head - next - (SHM_RING - 1),
+			   PRIVATE(gpsdata)->lost));
+	next = head - (SHM_RING - 1);
+	PRIVATE(gpsdata)->next = next;
+    }
+    return next;
+}
+
+static int shm_device_read(struct gps_data_t *gpsdata)
+/* read the next record from a per-device segment */
+{
+    volatile struct shmdevice_t *shared = PRIVATE(gpsdata)->device;
+    size_t stride = shared->stride;
+    union {
+	struct shmrecord_t hdr;
+	struct shmfix_t fix;
+	struct shmsky_t sky;
+	struct shmraw_t raw;
+    } rec;
+    int tries;
+
+    if (shm_gone(gpsdata))
+	return -1;
+    if (sizeof(rec) < stride)
+	return -1;		/* not a layout we know */
+
+    for (tries = 0; tries < SHM_RING; tries++) {
+	unsigned int head, next, before, after;
+	volatile struct shmrecord_t *slot;
+
+	memory_barrier();
+	head = shared->head;
+	memory_barrier();
+	if (0 > (int)(head - PRIVATE(gpsdata)->next))
+	    return 0;		/* nothing new */
+	next = shm_catch_up(gpsdata, head);
+	slot = (volatile struct shmrecord_t *)((volatile char *)(shared + 1)
+					       + (next % SHM_RING) * stride);
+
+	/* the reading half of the seqlock, as in gps_shm_read() */
+	before = slot->seq;
+	memory_barrier();
+	(void)memcpy((void *)&rec, (void *)slot, stride);
+	memory_barrier();
+	after = slot->seq;
+	if (before != 2 * next || after != before)
+	    continue;
+
+	switch (shared->class) {
+	case SHM_FIX:
+	    gpsdata->status = rec.fix.status;
+	    gpsdata->fix = rec.fix.fix;
+	    gpsdata->dop = rec.fix.dop;
+	    break;
+	case SHM_SKY:
+	    gpsdata->skyview_time = rec.sky.skyview_time;
+	    gpsdata->satellites_visible = rec.sky.satellites_visible;
+	    gpsdata->satellites_used = rec.sky.satellites_used;
+	    gpsdata->dop = rec.sky.dop;
+	    (void)memcpy(gpsdata->skyview, rec.sky.skyview,
+			 sizeof(gpsdata->skyview));
+	    break;
+	case SHM_RAW:
+	    gpsdata->raw = rec.raw.raw;
+	    break;
+	}
+	gpsdata->set = rec.hdr.set;
+	PRIVATE(gpsdata)->next = next + 1;
+	return (int)stride;
+    }
+    return 0;
+}
+
 int gps_shm_read(struct gps_data_t *gpsdata)
-/* read an update from the shared-memory segment */
+/* read the next update from the shared-memory segment */
 {
     if (gpsdata->privdata == NULL)
 	return -1;
+    else if (PRIVATE(gpsdata)->device != NULL)
+	return shm_device_read(gpsdata);
     else
     {
-	int before, after;
 	void *private_save = gpsdata->privdata;
 	volatile struct shmexport_t *shared = (struct shmexport_t *)PRIVATE(gpsdata)->shmseg;
 	struct gps_data_t noclobber;
+	int tries;
 
-	/*
-	 * Following block of instructions must not be reordered,
-	 * otherwise havoc will ensue.  The memory_barrier() call
-	 * should prevent reordering of the data accesses.
-	 *
-	 * This is a simple optimistic-concurrency technique.  We wrote
-	 * the second bookend first, then the data, then the first bookend.
-	 * Reader copies what it sees in normal order; that way, if we
-	 * start to write the segment during the read, the second bookend will
-	 * get clobbered first and the data can be detected as bad.
-	 */
-	before = shared->bookend1;
-	memory_barrier();
-	(void)memcpy((void *)&noclobber,
-		     (void *)&shared->gpsdata,
-		     sizeof(struct gps_data_t));
-	memory_barrier();
-	after = shared->bookend2;
+	/* give up for now if the writer laps us this often */
+	for (tries = 0; tries < SHM_RING; tries++) {
+	    unsigned int next, head, before, after;
+	    volatile struct shmslot_t *slot;
 
-	if (before != after)
-	    return 0;
-	else {
+	    memory_barrier();
+	    head = shared->head;
+	    memory_barrier();
+	    if (0 > (int)(head - PRIVATE(gpsdata)->next))
+		return 0;		/* nothing new */
+	    next = shm_catch_up(gpsdata, head);
+	    slot = &shared->slot[next % SHM_RING];
+
+	    /*
+	     * Following block of instructions must not be reordered,
+	     * otherwise havoc will ensue.  The memory_barrier() call
+	     * should prevent reordering of the data accesses.
+	     *
+	     * This is the reading half of a seqlock.  The slot holds the
+	     * update we want only if its sequence number is 2 * next both
+	     * before and after the copy; anything else means the writer
+	     * has been at the slot since, and we go round again.
+	     */
+	    before = slot->seq;
+	    memory_barrier();
+	    (void)memcpy((void *)&noclobber,
+			 (void *)&slot->gpsdata,
+			 sizeof(struct gps_data_t));
+	    memory_barrier();
+	    after = slot->seq;
+
+	    if (before != 2 * next || after != before)
+		continue;
 	    (void)memcpy((void *)gpsdata,
 			 (void *)&noclobber,
 			 sizeof(struct gps_data_t));
@@ -152,12 +378,13 @@ int gps_shm_read(struct gps_data_t *gpsdata)
 #else
 	    gpsdata->gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
 #endif /* USE_QT */
-	    PRIVATE(gpsdata)->tick = after;
+	    PRIVATE(gpsdata)->next = next + 1;
 	    if ((gpsdata->set & REPORT_IS)!=0) {
 		gpsdata->set = STATUS_SET;
 	    }
 	    return (int)sizeof(struct gps_data_t);
 	}
+	return 0;
     }
 }
 
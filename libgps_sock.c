@@ -40,6 +40,16 @@
 #ifdef SOCKET_EXPORT_ENABLE
 #include "gps_json.h"
 
+#ifdef UDP_EXPORT_ENABLE
+#include <netdb.h>
+#include <netinet/in.h>
+
+#define UDP_DEVICES	8	/* devices whose sequence we track */
+#endif /* UDP_EXPORT_ENABLE */
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+#include <zlib.h>
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
+
 struct privdata_t
 {
     bool newstyle;
@@ -49,6 +59,23 @@ struct privdata_t
 #ifdef LIBGPS_DEBUG
     int waitcount;
 #endif /* LIBGPS_DEBUG */
+#ifdef UDP_EXPORT_ENABLE
+    bool udp;			/* receiving datagrams from a UDP export */
+    struct {
+	char path[GPS_PATH_MAX];
+	unsigned int next;	/* sequence number expected next */
+    } udpseq[UDP_DEVICES];
+    unsigned long udplost;	/* datagrams known to be missing */
+#endif /* UDP_EXPORT_ENABLE */
+#if defined(SOCK_SEQPACKET) && !defined(USE_QT)
+    bool framed;		/* each read gets exactly one message */
+#endif /* defined(SOCK_SEQPACKET) && !defined(USE_QT) */
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    bool compress;		/* asked for a compressed stream */
+    bool inflating;		/* ...and the daemon started one */
+    z_stream z;
+    unsigned char zbuffer[GPS_JSON_RESPONSE_MAX * 2];
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
 };
 
 #ifdef HAVE_WINSOCK2_H
@@ -126,9 +153,176 @@ int gps_sock_open(const char *host, const char *port,
 #ifdef LIBGPS_DEBUG
     PRIVATE(gpsdata)->waitcount = 0;
 #endif /* LIBGPS_DEBUG */
+#ifdef UDP_EXPORT_ENABLE
+    PRIVATE(gpsdata)->udp = false;
+#endif /* UDP_EXPORT_ENABLE */
+#if defined(SOCK_SEQPACKET) && !defined(USE_QT)
+    PRIVATE(gpsdata)->framed = false;
+#endif /* defined(SOCK_SEQPACKET) && !defined(USE_QT) */
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    PRIVATE(gpsdata)->compress = false;
+    PRIVATE(gpsdata)->inflating = false;
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
+    return 0;
+}
+
+#if defined(SOCK_SEQPACKET) && !defined(USE_QT)
+int gps_local_open(const char *path, struct gps_data_t *gpsdata)
+/* connect to a daemon's local socket, which frames each message */
+{
+    libgps_debug_trace((DEBUG_CALLS, "gps_local_open(%s)\n", path));
+
+    if ((gpsdata->gps_fd = netlib_localsocket(path, SOCK_SEQPACKET)) < 0) {
+	errno = gpsdata->gps_fd;
+	libgps_debug_trace((DEBUG_CALLS,
+			   "netlib_localsocket() returns error %d\n",
+			   gpsdata->gps_fd));
+	return -1;
+    }
+
+    gpsdata->privdata = (void *)calloc(1, sizeof(struct privdata_t));
+    if (gpsdata->privdata == NULL)
+	return -1;
+    PRIVATE(gpsdata)->framed = true;
+    return 0;
+}
+
+static int framed_recv(struct gps_data_t *gpsdata)
+/* read one whole message into the empty buffer, returning like recv() */
+{
+    struct privdata_t *priv = PRIVATE(gpsdata);
+    struct iovec iov;
+    struct msghdr msg;
+    ssize_t got;
+
+    iov.iov_base = priv->buffer;
+    iov.iov_len = sizeof(priv->buffer) - 1;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    got = recvmsg(gpsdata->gps_fd, &msg, 0);
+    if (0 < got && 0 != (msg.msg_flags & MSG_TRUNC)) {
+	/* too big to be a report; drop it rather than misparse it */
+	libgps_debug_trace((DEBUG_CALLS, "framed message truncated\n"));
+	errno = EAGAIN;
+	return -1;
+    }
+    return (int)got;
+}
+#endif /* defined(SOCK_SEQPACKET) && !defined(USE_QT) */
+
+#if defined(UDP_EXPORT_ENABLE) && !defined(USE_QT)
+int gps_udp_open(const char *group, const char *port,
+		 struct gps_data_t *gpsdata)
+/* listen for datagrams from a daemon's UDP export; receive-only */
+{
+    char host[NI_MAXHOST];
+
+    if (!port)
+	port = DEFAULT_GPSD_PORT;
+    /* IPv6 groups may come bracketed, as in a URL */
+    if ('[' == group[0]) {
+	(void)strlcpy(host, group + 1, sizeof(host));
+	host[strcspn(host, "]")] = '\0';
+    } else
+	(void)strlcpy(host, group, sizeof(host));
+
+    libgps_debug_trace((DEBUG_CALLS, "gps_udp_open(%s, %s)\n", host, port));
+
+    /* netlib binds, rather than connects, a UDP socket */
+    if ((gpsdata->gps_fd =
+	netlib_connectsock(AF_UNSPEC, host, port, "udp")) < 0) {
+	errno = gpsdata->gps_fd;
+	libgps_debug_trace((DEBUG_CALLS,
+			   "netlib_connectsock() returns error %d\n",
+			   errno));
+	return -1;
+    }
+
+    /* join the group if it is one; broadcast needs nothing more */
+    {
+	struct sockaddr_storage ss;
+	socklen_t sslen = sizeof(ss);
+
+	if (0 == getsockname(gpsdata->gps_fd, (struct sockaddr *)&ss, &sslen)) {
+	    if (AF_INET == ss.ss_family) {
+		struct ip_mreq mreq;
+
+		mreq.imr_multiaddr = ((struct sockaddr_in *)&ss)->sin_addr;
+		mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+		if (IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr)))
+		    (void)setsockopt(gpsdata->gps_fd, IPPROTO_IP,
+				     IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+	    } else if (AF_INET6 == ss.ss_family) {
+		struct ipv6_mreq mreq6;
+
+		mreq6.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&ss)->sin6_addr;
+		mreq6.ipv6mr_interface = 0;
+		if (IN6_IS_ADDR_MULTICAST(&mreq6.ipv6mr_multiaddr))
+		    (void)setsockopt(gpsdata->gps_fd, IPPROTO_IPV6,
+				     IPV6_JOIN_GROUP, &mreq6, sizeof(mreq6));
+	    }
+	}
+    }
+
+    gpsdata->privdata = (void *)calloc(1, sizeof(struct privdata_t));
+    if (gpsdata->privdata == NULL)
+	return -1;
+    PRIVATE(gpsdata)->newstyle = true;
+    PRIVATE(gpsdata)->udp = true;
     return 0;
 }
 
+static void udp_header(struct gps_data_t *gpsdata)
+/* check and strip the sequence header off a just-received datagram */
+{
+    struct privdata_t *priv = PRIVATE(gpsdata);
+    char path[GPS_PATH_MAX];
+    unsigned int seq;
+    const char *end = NULL;
+    const struct json_attr_t json_attrs_udp[] = {
+	/* *INDENT-OFF* */
+	{"class",  t_check,    .dflt.check = "UDP"},
+	{"device", t_string,   .addr.string = path,
+				  .len = sizeof(path)},
+	{"seq",    t_uinteger, .addr.uinteger = &seq},
+	{NULL},
+	/* *INDENT-ON* */
+    };
+    char *eol = memchr(priv->buffer, '\n', (size_t)priv->waiting);
+    ssize_t hdrlen;
+    int i;
+
+    if (NULL == eol || 0 != json_read_object(priv->buffer, json_attrs_udp,
+					     &end))
+	return;		/* not from a UDP export; leave it to gps_unpack() */
+    hdrlen = eol - priv->buffer + 1;
+    priv->waiting -= hdrlen;
+    memmove(priv->buffer, eol + 1, (size_t)priv->waiting);
+
+    for (i = 0; i < UDP_DEVICES; i++)
+	if ('\0' == priv->udpseq[i].path[0]
+	    || 0 == strcmp(priv->udpseq[i].path, path))
+	    break;
+    if (UDP_DEVICES == i)
+	return;		/* too many devices to track; just deliver */
+    if ('\0' == priv->udpseq[i].path[0])
+	(void)strlcpy(priv->udpseq[i].path, path, sizeof(path));
+    else if (seq != priv->udpseq[i].next) {
+	unsigned int gap = seq - priv->udpseq[i].next;
+
+	/* a huge gap means the daemon restarted, not that we lost 4G */
+	if (gap < 0x80000000U) {
+	    priv->udplost += gap;
+	    libgps_debug_trace((DEBUG_CALLS,
+			       "UDP: lost %u datagram(s) from %s, "
+			       "%lu in all\n", gap, path, priv->udplost));
+	}
+    }
+    priv->udpseq[i].next = seq + 1;
+}
+#endif /* defined(UDP_EXPORT_ENABLE) && !defined(USE_QT) */
+
 bool gps_sock_waiting(const struct gps_data_t *gpsdata, int timeout)
 /* is there input waiting from the GPS? */
 /* timeout is in uSec */
@@ -138,6 +332,10 @@ bool gps_sock_waiting(const struct gps_data_t *gpsdata, int timeout)
                        timeout, PRIVATE(gpsdata)->waitcount++));
     if (PRIVATE(gpsdata)->waiting > 0)
 	return true;
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    if (PRIVATE(gpsdata)->inflating && 0 < PRIVATE(gpsdata)->z.avail_in)
+	return true;
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
 
     /* all error conditions return "not waiting" -- crude but effective */
     return nanowait(gpsdata->gps_fd, timeout * 1000);
@@ -149,6 +347,10 @@ bool gps_sock_waiting(const struct gps_data_t *gpsdata, int timeout)
 int gps_sock_close(struct gps_data_t *gpsdata)
 /* close a gpsd connection */
 {
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    if (PRIVATE(gpsdata)->inflating)
+	(void)inflateEnd(&PRIVATE(gpsdata)->z);
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
     free(PRIVATE(gpsdata));
     gpsdata->privdata = NULL;
 #ifndef USE_QT
@@ -172,28 +374,142 @@ int gps_sock_close(struct gps_data_t *gpsdata)
 #endif
 }
 
+static int binary_read(struct gps_data_t *gpsdata, char *message)
+/* unpack and consume a complete binary record at the head of the buffer */
+{
+    ssize_t reclen = binary_record_length(PRIVATE(gpsdata)->buffer,
+					  PRIVATE(gpsdata)->waiting);
+    int status;
+
+    if (0 >= reclen)
+	return 0;		/* not all here yet */
+    if (NULL != message)
+	*message = '\0';	/* there is no text to hand back */
+    (void)clock_gettime(CLOCK_REALTIME, &gpsdata->online);
+    status = libgps_binary_unpack(PRIVATE(gpsdata)->buffer,
+				  (size_t)reclen, gpsdata);
+    PRIVATE(gpsdata)->waiting -= reclen;
+    memmove(PRIVATE(gpsdata)->buffer, PRIVATE(gpsdata)->buffer + reclen,
+	    PRIVATE(gpsdata)->waiting);
+    gpsdata->set |= PACKET_SET;
+    return (status == 0) ? (int)reclen : status;
+}
+
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+static bool inflate_begin(struct gps_data_t *gpsdata)
+/* the stream is compressed from here on, including what's buffered */
+{
+    struct privdata_t *priv = PRIVATE(gpsdata);
+
+    memcpy(priv->zbuffer, priv->buffer, (size_t)priv->waiting);
+    priv->z.zalloc = Z_NULL;
+    priv->z.zfree = Z_NULL;
+    priv->z.opaque = Z_NULL;
+    priv->z.next_in = priv->zbuffer;
+    priv->z.avail_in = (uInt)priv->waiting;
+    if (Z_OK != inflateInit(&priv->z))
+	return false;
+    priv->waiting = 0;
+    priv->inflating = true;
+    return true;
+}
+
+static int inflate_recv(struct gps_data_t *gpsdata)
+/* fill the buffer from the compressed stream, returning like recv() */
+{
+    struct privdata_t *priv = PRIVATE(gpsdata);
+    size_t room = sizeof(priv->buffer) - (size_t)priv->waiting;
+    int status;
+
+    if (0 == priv->z.avail_in) {
+	ssize_t got = recv(gpsdata->gps_fd, priv->zbuffer,
+			   sizeof(priv->zbuffer), 0);
+	if (0 >= got)
+	    return (int)got;
+	priv->z.next_in = priv->zbuffer;
+	priv->z.avail_in = (uInt)got;
+    }
+    priv->z.next_out = (Bytef *)priv->buffer + priv->waiting;
+    priv->z.avail_out = (uInt)room;
+    status = inflate(&priv->z, Z_SYNC_FLUSH);
+    if (Z_OK != status && Z_BUF_ERROR != status) {
+	libgps_debug_trace((DEBUG_CALLS, "inflate() failed: %d\n", status));
+	errno = EPROTO;
+	return -1;
+    }
+    if (0 < room && room == priv->z.avail_out) {
+	/* the middle of a block; try again when there's more */
+	errno = EAGAIN;
+	return -1;
+    }
+    return (int)(room - priv->z.avail_out);
+}
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
+
 int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
 /* wait for and read data being streamed from the daemon */
 {
     char *eol;
     ssize_t response_length;
     int status = -1;
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    bool inflate_next = false;
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
 
     errno = 0;
     gpsdata->set &= ~PACKET_SET;
 
-    /* scan to find end of message (\n), or end of buffer */
-    for (eol = PRIVATE(gpsdata)->buffer;
-	 eol < (PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->waiting);
-         eol++) {
-        if ('\n' == *eol)
-            break;
+#if defined(SOCK_SEQPACKET) && !defined(USE_QT)
+    if (PRIVATE(gpsdata)->framed
+#ifdef ZLIB_ENABLE
+	&& !PRIVATE(gpsdata)->inflating
+#endif /* ZLIB_ENABLE */
+	) {
+	/* the socket hands over one message a read; nothing to scan */
+	status = framed_recv(gpsdata);
+	if (0 >= status)
+	    return (0 > status && (EAGAIN == errno || EINTR == errno
+				   || EWOULDBLOCK == errno)) ? 0 : -1;
+	PRIVATE(gpsdata)->waiting = status;
+	if (BINARY_MAGIC == (unsigned char)PRIVATE(gpsdata)->buffer[0])
+	    return binary_read(gpsdata, message);
+	eol = PRIVATE(gpsdata)->buffer + status - 1;
+	if ('\n' != *eol) {
+	    PRIVATE(gpsdata)->waiting = 0;	/* not from gpsd */
+	    return 0;
+	}
+    } else
+#endif /* defined(SOCK_SEQPACKET) && !defined(USE_QT) */
+    if (0 < PRIVATE(gpsdata)->waiting &&
+	BINARY_MAGIC == (unsigned char)PRIVATE(gpsdata)->buffer[0]) {
+	/* a binary record is not newline-framed, it carries its length */
+	if (0 != (status = binary_read(gpsdata, message)))
+	    return status;
+	eol = PRIVATE(gpsdata)->buffer;		/* force a read */
+    } else {
+	/* scan to find end of message (\n), or end of buffer */
+	for (eol = PRIVATE(gpsdata)->buffer;
+	     eol < (PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->waiting);
+	     eol++) {
+	    if ('\n' == *eol)
+		break;
+	}
     }
 
     if (*eol != '\n') {
 	/* no full message found, try to fill buffer */
 
+#if defined(UDP_EXPORT_ENABLE) && !defined(USE_QT)
+	/* datagrams hold whole lines, so any leftover is junk */
+	if (PRIVATE(gpsdata)->udp)
+	    PRIVATE(gpsdata)->waiting = 0;
+#endif /* defined(UDP_EXPORT_ENABLE) && !defined(USE_QT) */
 #ifndef USE_QT
+#ifdef ZLIB_ENABLE
+	if (PRIVATE(gpsdata)->inflating)
+	    status = inflate_recv(gpsdata);
+	else
+#endif /* ZLIB_ENABLE */
 	/* read data: return -1 if no data waiting or buffered, 0 otherwise */
 	status = (int)recv(gpsdata->gps_fd,
                PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->waiting,
@@ -303,6 +619,13 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
 
 	/* if we just received data from the socket, it's in the buffer */
 	PRIVATE(gpsdata)->waiting += status;
+#if defined(UDP_EXPORT_ENABLE) && !defined(USE_QT)
+	if (PRIVATE(gpsdata)->udp)
+	    udp_header(gpsdata);
+#endif /* defined(UDP_EXPORT_ENABLE) && !defined(USE_QT) */
+	if (0 < PRIVATE(gpsdata)->waiting &&
+	    BINARY_MAGIC == (unsigned char)PRIVATE(gpsdata)->buffer[0])
+	    return binary_read(gpsdata, message);
 
 	/* there's new buffered data waiting, check for full message */
 	for (eol = PRIVATE(gpsdata)->buffer;
@@ -322,6 +645,12 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
         strlcpy(message, PRIVATE(gpsdata)->buffer, message_len);
     }
     (void)clock_gettime(CLOCK_REALTIME, &gpsdata->online);
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    /* the WATCH response that agrees to compress is the last plain text */
+    inflate_next = PRIVATE(gpsdata)->compress && !PRIVATE(gpsdata)->inflating
+	&& str_starts_with(PRIVATE(gpsdata)->buffer, "{\"class\":\"WATCH\",")
+	&& NULL != strstr(PRIVATE(gpsdata)->buffer, "\"compress\":true");
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
     /* unpack the JSON message */
     status = gps_unpack(PRIVATE(gpsdata)->buffer, gpsdata);
 
@@ -340,6 +669,10 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
 		PRIVATE(gpsdata)->buffer + response_length,
 		PRIVATE(gpsdata)->waiting);
     }
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+    if (inflate_next && !inflate_begin(gpsdata))
+	return -1;
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
     gpsdata->set |= PACKET_SET;
 
     return (status == 0) ? (int)response_length : status;
@@ -435,6 +768,10 @@ int gps_sock_stream(struct gps_data_t *gpsdata, unsigned int flags, void *d)
 	    (void)strlcat(buf, "\"split24\":false,", sizeof(buf));
 	if (flags & WATCH_PPS)
 	    (void)strlcat(buf, "\"pps\":false,", sizeof(buf));
+	if (flags & WATCH_BINARY)
+	    (void)strlcat(buf, "\"binary\":false,", sizeof(buf));
+	if (flags & WATCH_DELTA)
+	    (void)strlcat(buf, "\"delta\":false,", sizeof(buf));
 	str_rstrip_char(buf, ',');
 	(void)strlcat(buf, "};", sizeof(buf));
 	libgps_debug_trace((DEBUG_CALLS,
@@ -458,6 +795,16 @@ int gps_sock_stream(struct gps_data_t *gpsdata, unsigned int flags, void *d)
 	    (void)strlcat(buf, "\"split24\":true,", sizeof(buf));
 	if (flags & WATCH_PPS)
 	    (void)strlcat(buf, "\"pps\":true,", sizeof(buf));
+	if (flags & WATCH_BINARY)
+	    (void)strlcat(buf, "\"binary\":true,", sizeof(buf));
+	if (flags & WATCH_DELTA)
+	    (void)strlcat(buf, "\"delta\":true,", sizeof(buf));
+#if defined(ZLIB_ENABLE) && !defined(USE_QT)
+	if (flags & WATCH_COMPRESS) {
+	    (void)strlcat(buf, "\"compress\":true,", sizeof(buf));
+	    PRIVATE(gpsdata)->compress = true;
+	}
+#endif /* defined(ZLIB_ENABLE) && !defined(USE_QT) */
 	if (flags & WATCH_DEVICE)
 	    str_appendf(buf, sizeof(buf), "\"device\":\"%s\",", (char *)d);
 	str_rstrip_char(buf, ',');
@@ -97,15 +97,16 @@ static void visibilize(char *outbuf, size_t outlen,
 		       const char *inbuf, size_t inlen)
 {
     const char *sp;
+    size_t len = 0;
 
-    outbuf[0] = '\0';
-    for (sp = inbuf; sp < inbuf + inlen && strlen(outbuf)+6 < outlen; sp++)
+    for (sp = inbuf; sp < inbuf + inlen && len + 6 < outlen; sp++)
 	if (isprint((unsigned char) *sp) || (sp[0] == '\n' && sp[1] == '\0')
 	  || (sp[0] == '\r' && sp[2] == '\0'))
-	    (void)snprintf(outbuf + strlen(outbuf), 2, "%c", *sp);
+	    outbuf[len++] = *sp;
 	else
-	    (void)snprintf(outbuf + strlen(outbuf), 6, "\\x%02x",
-			   0x00ff & (unsigned)*sp);
+	    len += snprintf(outbuf + len, 6, "\\x%02x",
+			    0x00ff & (unsigned)*sp);
+    outbuf[len] = '\0';
 }
 #endif /* !SQUELCH_ENABLE */
 
@@ -130,7 +131,6 @@ static void gpsd_vlog(const int errlevel,
         return;
     }
 
-    gpsd_acquire_reporting_lock();
     switch ( errlevel ) {
     case LOG_ERROR:
             err_str = "ERROR: ";
@@ -174,13 +174,21 @@ static void gpsd_vlog(const int errlevel,
 
     visibilize(outbuf, outlen, buf, strlen(buf));
 
+    /*
+     * Everything above works on our own buffers, so only delivery
+     * needs serializing, and syslog(3) and stdio lock for themselves.
+     * Only a custom hook, such as gpsmon's curses window, takes the
+     * reporting lock.
+     */
     if (getpid() == getsid(getpid()))
         syslog((errlevel <= LOG_SHOUT) ? LOG_ERR : LOG_NOTICE, "%s", outbuf);
-    else if (errout->report != NULL)
-        errout->report(outbuf);
-    else
+    else if (NULL == errout->report || basic_report == errout->report)
         (void)fputs(outbuf, stderr);
-    gpsd_release_reporting_lock();
+    else {
+        gpsd_acquire_reporting_lock();
+        errout->report(outbuf);
+        gpsd_release_reporting_lock();
+    }
 #endif /* !SQUELCH_ENABLE */
 }
 
@@ -283,6 +291,7 @@ void gps_context_init(struct gps_context_t *context,
     //context.readonly = false;
     context->leap_notify    = LEAP_NOWARNING;
     context->serial_write = gpsd_serial_write;
+    context->udpfd = -1;
 
     errout_reset(&context->errout);
     context->errout.label = (char *)label;
@@ -324,6 +333,7 @@ void gpsd_init(struct gps_device_t *session, struct gps_context_t *context,
     session->sor.tv_sec = 0;
     session->sor.tv_nsec = 0;
     session->chars = 0;
+    session->overbudget = false;
     /* tty-level initialization */
     gpsd_tty_init(session);
     /* necessary in case we start reading in the middle of a GPGSV sequence */
@@ -346,6 +356,8 @@ void gpsd_deactivate(struct gps_device_t *session)
     GPSD_LOG(LOG_INF, &session->context->errout,
 	     "closing GPS=%s (%d)\n",
 	     session->gpsdata.dev.path, session->gpsdata.gps_fd);
+    if (session->context->close_hook != NULL)
+	session->context->close_hook(session);
 #if defined(NMEA2000_ENABLE)
     if (session->sourcetype == source_can)
         (void)nmea2000_close(session);
@@ -361,6 +373,7 @@ void gpsd_deactivate(struct gps_device_t *session)
     /* mark it inactivated */
     session->gpsdata.online.tv_sec = 0;
     session->gpsdata.online.tv_nsec = 0;
+    session->overbudget = false;
 }
 
 static void ppsthread_log(volatile struct pps_thread_t *pps_thread,
@@ -1721,6 +1734,10 @@ int gpsd_multipoll(const bool data_ready,
     if (data_ready)
     {
 	int fragments;
+	size_t outlen, consumed = 0;
+	bool leftover = device->overbudget;
+
+	device->overbudget = false;
 
 	GPSD_LOG(LOG_RAW + 1, &device->context->errout,
 		 "polling %d\n", device->gpsdata.gps_fd);
@@ -1764,8 +1781,10 @@ int gpsd_multipoll(const bool data_ready,
 		/*
 		 * No data on the first fragment read means the device
 		 * fd may have been in an end-of-file condition on select.
+		 * Not so if all we were doing is finishing input left
+		 * over when the previous call ran out of budget.
 		 */
-		if (fragments == 0) {
+		if (fragments == 0 && !leftover) {
 		    GPSD_LOG(LOG_DATA, &device->context->errout,
 			     "%s returned zero bytes\n",
 			     device->gpsdata.dev.path);
@@ -1831,25 +1850,28 @@ int gpsd_multipoll(const bool data_ready,
 
 
 	    /* handle data contained in this packet */
+	    outlen = device->lexer.outbuflen;
 	    if (device->lexer.type != BAD_PACKET)
 		handler(device, changed);
 
-#ifdef __future__
-            // this breaks: test/daemon/passthrough.log ??
 	    /*
-	     * Bernd Ocklin suggests:
-	     * Exit when a full packet was received and parsed.
-	     * This allows other devices to be serviced even if
-	     * this device delivers a full packet at every single
-	     * read.
-	     * Otherwise we can sit here for a long time without
-	     * any for-loop exit condition being met.
-             * It might also reduce the latency from a received packet to
-             * it being output by gpsd.
+	     * Bernd Ocklin suggested exiting after each full packet so
+	     * other devices get serviced even if this one delivers a
+	     * packet on every read.  That is now the per-call budget
+	     * in the context, in packets and/or bytes; zero means no
+	     * limit.  Input left in the lexer buffer is not lost, but
+	     * the fd may never show readable again, so we flag it in
+	     * overbudget and callers that set a budget must poll such
+	     * a device on their next pass as if it were ready.
 	     */
-	    if ((changed & PACKET_SET) != 0)
-               break;
-#endif /* __future__ */
+	    consumed += outlen;
+	    if ((0 < device->context->poll_packets
+		 && (unsigned)fragments + 1 >= device->context->poll_packets)
+		|| (0 < device->context->poll_bytes
+		    && consumed >= device->context->poll_bytes)) {
+		device->overbudget = 0 < packet_buffered_input(&device->lexer);
+		break;
+	    }
 	}
     }
     else if (device->reawake>0 && time(NULL) >device->reawake) {
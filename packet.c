@@ -40,6 +40,11 @@ PERMISSIONS
 #include <sys/time.h>           // for struct timeval
 #include <sys/types.h>
 #include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #include "bits.h"
 #include "driver_greis.h"
@@ -127,12 +132,20 @@ PERMISSIONS
 enum
 {
 #include "packet_states.h"
+   PACKET_STATES	/* not a state, the count of them */
 };
 
 static char *state_table[] = {
 #include "packet_names.h"
 };
 
+/*
+ * States whose next state depends on nothing but the input byte are
+ * described in packetgen.py, which builds lookup tables for them; those
+ * never reach the switch in nextstate().  Edit the tables there.
+ */
+#include "packet_table.i"	/* generated by packetgen.py */
+
 #define SOH	(unsigned char)0x01
 #define DLE	(unsigned char)0x10
 #define STX	(unsigned char)0x02
@@ -238,10 +251,10 @@ static bool character_pushback(struct gps_lexer_t *lexer, unsigned int newstate)
 }
 
 static void character_discard(struct gps_lexer_t *lexer)
-/* shift the input buffer to discard one character and reread data */
+/* slide the input window to discard one character and reread data */
 {
-    memmove(lexer->inbuffer, lexer->inbuffer + 1, (size_t)-- lexer->inbuflen);
-    lexer->inbufptr = lexer->inbuffer;
+    lexer->inbufptr = ++lexer->inbuffer;
+    --lexer->inbuflen;
     if (lexer->errout.debug >= LOG_RAW + 1) {
 	char scratchbuf[MAX_PACKET_LENGTH*4+1];
 	GPSD_LOG(LOG_RAW + 1, &lexer->errout,
@@ -397,300 +410,7 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	    return character_pushback(lexer, JSON_LEADER);
 #endif /* PASSTHROUGH_ENABLE */
 	break;
-    case COMMENT_BODY:
-	if (c == '\n')
-	    lexer->state = COMMENT_RECOGNIZED;
-	else if (!isprint(c))
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #ifdef NMEA0183_ENABLE
-    case NMEA_DOLLAR:
-	if (c == 'G')
-	    lexer->state = NMEA_PUB_LEAD;
-	else if (c == 'P')	/* vendor sentence */
-	    lexer->state = NMEA_VENDOR_LEAD;
-	else if (c == 'I')	/* Seatalk */
-	    lexer->state = SEATALK_LEAD_1;
-	else if (c == 'W')	/* Weather instrument */
-	    lexer->state = WEATHER_LEAD_1;
-	else if (c == 'H')	/* Heading/compass */
-	    lexer->state = HEADCOMP_LEAD_1;
-	else if (c == 'T')	/* Turn indicator */
-	    lexer->state = TURN_LEAD_1;
-	else if (c == 'A')	/* SiRF Ack */
-	    lexer->state = SIRF_ACK_LEAD_1;
-	else if (c == 'E')	/* ECDIS */
-	    lexer->state = ECDIS_LEAD_1;
-	else if (c == 'S')
-	    lexer->state = SOUNDER_LEAD_1;
-	else if (c == 'Y')
-	    lexer->state = TRANSDUCER_LEAD_1;
-	else if (c == 'B')
-	    lexer->state = BEIDOU_LEAD_1;
-	else if (c == 'Q') {
-	    lexer->state = QZSS_LEAD_1;
-#ifdef OCEANSERVER_ENABLE
-	} else if (c == 'C') {
-            // is this ever used?
-	    lexer->state = NMEA_LEADER_END;
-	} else if (c == 'O') {
-            // for $OHPR
-	    lexer->state = NMEA_LEADER_END;
-#endif /* OCEANSERVER_ENABLE */
-	} else {
-	    (void) character_pushback(lexer, GROUND_STATE);
-        }
-	break;
-    case NMEA_PUB_LEAD:
-	/*
-	 * $GP == GPS, $GL = GLONASS only, $GN = mixed GPS and GLONASS,
-	 * according to NMEA (IEIC 61162-1) DRAFT 02/06/2009.
-	 * We have a log from China with a Beidou device using $GB
-	 * rather than $BD.
-	 */
-	if (c == 'B' || c == 'P' || c == 'N' || c == 'L' || c == 'A')
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    case NMEA_VENDOR_LEAD:
-	if (c == 'A')
-	    lexer->state = NMEA_PASHR_A;
-	else if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    /*
-     * Without the following six states, DLE in a $PASHR can fool the
-     * sniffer into thinking it sees a TSIP packet.  Hilarity ensues.
-     */
-    case NMEA_PASHR_A:
-	if (c == 'S')
-	    lexer->state = NMEA_PASHR_S;
-	else if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    case NMEA_PASHR_S:
-	if (c == 'H')
-	    lexer->state = NMEA_PASHR_H;
-	else if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    case NMEA_PASHR_H:
-	if (c == 'R')
-	    lexer->state = NMEA_BINARY_BODY;
-	else if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    case NMEA_BINARY_BODY:
-	if (c == '\r')
-	    lexer->state = NMEA_BINARY_CR;
-	break;
-    case NMEA_BINARY_CR:
-	if (c == '\n')
-	    lexer->state = NMEA_BINARY_NL;
-	else
-	    lexer->state = NMEA_BINARY_BODY;
-	break;
-    case NMEA_BINARY_NL:
-	if (c == '$')
-	    (void) character_pushback(lexer, NMEA_RECOGNIZED);
-	else
-	    lexer->state = NMEA_BINARY_BODY;
-	break;
-    case NMEA_BANG:
-	if (c == 'A')
-	    lexer->state = AIS_LEAD_1;
-	else if (c == 'B')
-	    lexer->state = AIS_LEAD_ALT1;
-	else if (c == 'S')
-	    lexer->state = AIS_LEAD_ALT3;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case AIS_LEAD_1:
-	if (strchr("BDINRSTX", c) != NULL)
-	    lexer->state = AIS_LEAD_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case AIS_LEAD_2:
-	if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case AIS_LEAD_ALT1:
-	if (c == 'S')
-	    lexer->state = AIS_LEAD_ALT2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case AIS_LEAD_ALT2:
-	if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case AIS_LEAD_ALT3:
-	if (c == 'A')
-	    lexer->state = AIS_LEAD_ALT4;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case AIS_LEAD_ALT4:
-	if (isalpha(c))
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-#if defined(TNT_ENABLE) || defined(GARMINTXT_ENABLE) || defined(ONCORE_ENABLE)
-    case AT1_LEADER:
-	switch (c) {
-#ifdef ONCORE_ENABLE
-	case '@':
-	    lexer->state = ONCORE_AT2;
-	    break;
-#endif /* ONCORE_ENABLE */
-#ifdef TNT_ENABLE
-	case '*':
-	    /*
-	     * TNT has similar structure to NMEA packet, '*' before
-	     * optional checksum ends the packet. Since '*' cannot be
-	     * received from GARMIN working in TEXT mode, use this
-	     * difference to tell that this is not GARMIN TEXT packet,
-	     * could be TNT.
-	     */
-	    lexer->state = NMEA_LEADER_END;
-	    break;
-#endif /* TNT_ENABLE */
-#if defined(GARMINTXT_ENABLE)
-	case '\r':
-	    /* stay in this state, next character should be '\n' */
-	    /* in the theory we can stop search here and don't wait for '\n' */
-	    lexer->state = AT1_LEADER;
-	    break;
-	case '\n':
-	    /* end of packet found */
-	    lexer->state = GTXT_RECOGNIZED;
-	    break;
-#endif /* GARMINTXT_ENABLE */
-	default:
-	    if (!isprint(c))
-		return character_pushback(lexer, GROUND_STATE);
-	}
-	break;
-#endif /* defined(TNT_ENABLE) || defined(GARMINTXT_ENABLE) || defined(ONCORE_ENABLE) */
-    case NMEA_LEADER_END:
-	if (c == '\r')
-	    lexer->state = NMEA_CR;
-	else if (c == '\n')
-	    /* not strictly correct, but helps for interpreting logfiles */
-	    lexer->state = NMEA_RECOGNIZED;
-	else if (c == '$') {
-#ifdef STASH_ENABLE
-	    (void) character_pushback(lexer, STASH_RECOGNIZED);
-#else
-	    (void) character_pushback(lexer, GROUND_STATE);
-#endif
-	} else if (!isprint(c))
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    case NMEA_CR:
-	if (c == '\n')
-	    lexer->state = NMEA_RECOGNIZED;
-	/*
-	 * There's a GPS called a Jackson Labs Firefly-1a that emits \r\r\n
-	 * at the end of each sentence.  Don't be confused by this.
-	 */
-	else if (c == '\r')
-	    lexer->state = NMEA_CR;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
-    case NMEA_RECOGNIZED:
-	if (c == '#')
-	    lexer->state = COMMENT_BODY;
-	else if (c == '$')
-	    lexer->state = NMEA_DOLLAR;
-	else if (c == '!')
-	    lexer->state = NMEA_BANG;
-#ifdef UBLOX_ENABLE
-	else if (c == 0xb5)	/* LEA-5H can and will output NMEA and UBX back to back */
-	    lexer->state = UBX_LEADER_1;
-#endif
-#ifdef PASSTHROUGH_ENABLE
-	else if (c == '{')
-	    return character_pushback(lexer, JSON_LEADER);
-#endif /* PASSTHROUGH_ENABLE */
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case SEATALK_LEAD_1:
-	if (c == 'I' || c == 'N')	/* II or IN are accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case WEATHER_LEAD_1:
-	if (c == 'I')		/* Weather instrument leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case HEADCOMP_LEAD_1:
-	if (c == 'C')		/* Heading/compass leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case TURN_LEAD_1:
-	if (c == 'I')		/* Turn indicator leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case ECDIS_LEAD_1:
-	if (c == 'C')		/* ECDIS leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case SOUNDER_LEAD_1:
-	if (c == 'D')		/* Depth-sounder leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-#ifdef SKYTRAQ_ENABLE
-	else if (c == 'T')		/* $ST leader accepted, to $STI */
-	    lexer->state = NMEA_LEADER_END;
-#endif /* SKYTRAQ_ENABLE */
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case TRANSDUCER_LEAD_1:
-	if (c == 'X')		/* Transducer leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case BEIDOU_LEAD_1:
-	if (c == 'D')		/* Beidou leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case QZSS_LEAD_1:
-	if (c == 'Z')		/* QZSS leader accepted */
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #ifdef TRIPMATE_ENABLE
     case ASTRAL_1:
 	if (c == 'S') {
@@ -845,38 +565,7 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	    (void) character_pushback(lexer, GROUND_STATE);
 	break;
 #endif /* EARTHMATE_ENABLE */
-    case SIRF_ACK_LEAD_1:
-	if (c == 'c')
-	    lexer->state = SIRF_ACK_LEAD_2;
-	else if (c == 'I')
-	    lexer->state = AIS_LEAD_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case SIRF_ACK_LEAD_2:
-	if (c == 'k')
-	    lexer->state = NMEA_LEADER_END;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* NMEA0183_ENABLE */
-#if defined(SIRF_ENABLE) || defined(SKYTRAQ_ENABLE)
-    case SIRF_LEADER_1:
-# ifdef SIRF_ENABLE
-        /* SIRF leads with 0xA0,0xA2 */
-	if (c == 0xa2)
-	    lexer->state = SIRF_LEADER_2;
-	else
-# endif /* SIRF_ENABLE */
-# ifdef SKYTRAQ_ENABLE
-        /* Skytraq leads with 0xA0,0xA1 */
-	if (c == 0xa1)
-	    lexer->state = SKY_LEADER_2;
-	else
-# endif /* SKYTRAQ_ENABLE */
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-#endif /* SIRF_ENABLE || SKYTRAQ_ENABLE */
 #ifdef SIRF_ENABLE
     case SIRF_LEADER_2:
 	lexer->length = (size_t) (c << 8);
@@ -893,24 +582,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	if (--lexer->length == 0)
 	    lexer->state = SIRF_DELIVERED;
 	break;
-    case SIRF_DELIVERED:
-	if (c == 0xb0)
-	    lexer->state = SIRF_TRAILER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case SIRF_TRAILER_1:
-	if (c == 0xb3)
-	    lexer->state = SIRF_RECOGNIZED;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case SIRF_RECOGNIZED:
-	if (c == 0xa0)
-	    lexer->state = SIRF_LEADER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* SIRF_ENABLE */
 #ifdef SKYTRAQ_ENABLE
     case SKY_LEADER_2:
@@ -956,21 +627,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	}
 	lexer->state = SKY_CSUM;
 	break;
-    case SKY_CSUM:
-	if ( 0x0d != c)
-	    return character_pushback(lexer, GROUND_STATE);
-	lexer->state = SKY_TRAILER_1;
-	break;
-    case SKY_TRAILER_1:
-	if ( 0x0a != c)
-	    return character_pushback(lexer, GROUND_STATE);
-	lexer->state = SKY_RECOGNIZED;
-	break;
-    case SKY_RECOGNIZED:
-	if ( 0xa0 != c)
-	    return character_pushback(lexer, GROUND_STATE);
-	lexer->state = SIRF_LEADER_1;
-	break;
 #endif /* SKYTRAQ */
 #ifdef SUPERSTAR2_ENABLE
     case SUPERSTAR2_LEADER:
@@ -1000,12 +656,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
     case SUPERSTAR2_CKSUM2:
 	lexer->state = SUPERSTAR2_RECOGNIZED;
 	break;
-    case SUPERSTAR2_RECOGNIZED:
-	if (c == SOH)
-	    lexer->state = SUPERSTAR2_LEADER;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* SUPERSTAR2_ENABLE */
 #ifdef ONCORE_ENABLE
     case ONCORE_AT2:
@@ -1030,24 +680,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	if (--lexer->length == 0)
 	    lexer->state = ONCORE_CHECKSUM;
 	break;
-    case ONCORE_CHECKSUM:
-	if (c != '\r')
-	    return character_pushback(lexer, GROUND_STATE);
-	else
-	    lexer->state = ONCORE_CR;
-	break;
-    case ONCORE_CR:
-	if (c == '\n')
-	    lexer->state = ONCORE_RECOGNIZED;
-	else
-	    lexer->state = ONCORE_PAYLOAD;
-	break;
-    case ONCORE_RECOGNIZED:
-	if (c == '@')
-	    lexer->state = AT1_LEADER;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* ONCORE_ENABLE */
 #if defined(TSIP_ENABLE) || defined(EVERMORE_ENABLE) || defined(GARMIN_ENABLE)
     case DLE_LEADER:
@@ -1076,18 +708,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	break;
 #endif /* TSIP_ENABLE */
 #ifdef NAVCOM_ENABLE
-    case NAVCOM_LEADER_1:
-	if (c == 0x99)
-	    lexer->state = NAVCOM_LEADER_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case NAVCOM_LEADER_2:
-	if (c == 0x66)
-	    lexer->state = NAVCOM_LEADER_3;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
     case NAVCOM_LEADER_3:
 	lexer->state = NAVCOM_ID;
 	break;
@@ -1121,18 +741,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
     }
 	lexer->state = NAVCOM_CSUM;
 	break;
-    case NAVCOM_CSUM:
-	if (c == 0x03)
-	    lexer->state = NAVCOM_RECOGNIZED;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case NAVCOM_RECOGNIZED:
-	if (c == 0x02)
-	    lexer->state = NAVCOM_LEADER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* NAVCOM_ENABLE */
 #endif /* TSIP_ENABLE || EVERMORE_ENABLE || GARMIN_ENABLE */
 #ifdef RTCM104V3_ENABLE
@@ -1156,19 +764,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	break;
 #endif /* RTCM104V3_ENABLE */
 #ifdef ZODIAC_ENABLE
-    case ZODIAC_EXPECTED:
-    case ZODIAC_RECOGNIZED:
-	if (c == 0xff)
-	    lexer->state = ZODIAC_LEADER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case ZODIAC_LEADER_1:
-	if (c == 0x81)
-	    lexer->state = ZODIAC_LEADER_2;
-	else
-	    (void) character_pushback(lexer, GROUND_STATE);
-	break;
     case ZODIAC_LEADER_2:
 	lexer->state = ZODIAC_ID_1;
 	break;
@@ -1227,12 +822,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	break;
 #endif /* ZODIAC_ENABLE */
 #ifdef UBLOX_ENABLE
-    case UBX_LEADER_1:
-	if (c == 0x62)
-	    lexer->state = UBX_LEADER_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
     case UBX_LEADER_2:
 	lexer->state = UBX_CLASS_ID;
 	break;
@@ -1261,28 +850,8 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
     case UBX_CHECKSUM_A:
 	lexer->state = UBX_RECOGNIZED;
 	break;
-    case UBX_RECOGNIZED:
-	if (c == 0xb5)
-	    lexer->state = UBX_LEADER_1;
-#ifdef NMEA0183_ENABLE
-	else if (c == '$')	/* LEA-5H can and will output NMEA and UBX back to back */
-	    lexer->state = NMEA_DOLLAR;
-#endif /* NMEA0183_ENABLE */
-#ifdef PASSTHROUGH_ENABLE
-	else if (c == '{')
-	    return character_pushback(lexer, JSON_LEADER);
-#endif /* PASSTHROUGH_ENABLE */
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* UBLOX_ENABLE */
 #ifdef EVERMORE_ENABLE
-    case EVERMORE_LEADER_1:
-	if (c == STX)
-	    lexer->state = EVERMORE_LEADER_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
     case EVERMORE_LEADER_2:
 	lexer->length = (size_t) c;
 	if (c == DLE)
@@ -1308,20 +877,8 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	    lexer->state = GROUND_STATE;
 	}
 	break;
-    case EVERMORE_RECOGNIZED:
-	if (c == DLE)
-	    lexer->state = EVERMORE_LEADER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* EVERMORE_ENABLE */
 #ifdef ITRAX_ENABLE
-    case ITALK_LEADER_1:
-	if (c == '!')
-	    lexer->state = ITALK_LEADER_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
     case ITALK_LEADER_2:
 	lexer->length = (size_t) (lexer->inbuffer[6] & 0xff);
 	lexer->state = ITALK_LENGTH;
@@ -1334,8 +891,8 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	break;
     case ITALK_PAYLOAD:
 	/* lookahead for "<!" because sometimes packets are short but valid */
-	if ((c == '>') && (lexer->inbufptr[0] == '<') &&
-	    (lexer->inbufptr[1] == '!')) {
+	if ((c == '>') && 2 <= packet_buffered_input(lexer) &&
+	    (lexer->inbufptr[0] == '<') && (lexer->inbufptr[1] == '!')) {
 	    lexer->state = ITALK_RECOGNIZED;
 	    GPSD_LOG(LOG_IO, &lexer->errout,
 		     "ITALK: trying to process runt packet\n");
@@ -1343,38 +900,8 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	} else if (--lexer->length == 0)
 	    lexer->state = ITALK_DELIVERED;
 	break;
-    case ITALK_DELIVERED:
-	if (c == '>')
-	    lexer->state = ITALK_RECOGNIZED;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case ITALK_RECOGNIZED:
-	if (c == '<')
-	    lexer->state = ITALK_LEADER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* ITRAX_ENABLE */
 #ifdef GEOSTAR_ENABLE
-    case GEOSTAR_LEADER_1:
-	if (c == 'S')
-	    lexer->state = GEOSTAR_LEADER_2;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case GEOSTAR_LEADER_2:
-	if (c == 'G')
-	    lexer->state = GEOSTAR_LEADER_3;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
-    case GEOSTAR_LEADER_3:
-	if (c == 'G')
-	    lexer->state = GEOSTAR_LEADER_4;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
     case GEOSTAR_LEADER_4:
 	lexer->state = GEOSTAR_MESSAGE_ID_1;
 	break;
@@ -1409,12 +936,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
     case GEOSTAR_CHECKSUM_C:
 	lexer->state = GEOSTAR_RECOGNIZED;
 	break;
-    case GEOSTAR_RECOGNIZED:
-	if (c == 'P')
-	    lexer->state = GEOSTAR_LEADER_1;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* GEOSTAR_ENABLE */
 #ifdef GREIS_ENABLE
     case GREIS_EXPECTED:
@@ -1432,16 +953,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	    lexer->state = GREIS_ID_1;
 	}
 	break;
-    case GREIS_REPLY_1:
-	if (c != 'E')
-	    return character_pushback(lexer, GROUND_STATE);
-	lexer->state = GREIS_REPLY_2;
-	break;
-    case GREIS_ID_1:
-	if (!isascii(c))
-	    return character_pushback(lexer, GROUND_STATE);
-	lexer->state = GREIS_ID_2;
-	break;
     case GREIS_REPLY_2:
     case GREIS_ID_2:
 	if (!isxdigit(c))
@@ -1499,18 +1010,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	    break;
 	}
 	break;
-    case TSIP_RECOGNIZED:
-	if (c == DLE)
-	    /*
-	     * Don't go to TSIP_LEADER state -- TSIP packets aren't
-	     * checksummed, so false positives are easy.  We might be
-	     * looking at another DLE-stuffed protocol like EverMore
-	     * or Garmin streaming binary.
-	     */
-	    lexer->state = DLE_LEADER;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* TSIP_ENABLE */
 #ifdef RTCM104V2_ENABLE
     case RTCM2_SYNC_STATE:
@@ -1566,15 +1065,6 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
     case JSON_STRING_SOLIDUS:
 	lexer->state = JSON_STRINGLITERAL;
 	break;
-    case JSON_END_ATTRIBUTE:
-	if (isspace(c))
-	    break;
-	else if (c == ':')
-	    lexer->state = JSON_EXPECT_VALUE;
-	else
-	    /* saw something other than value start after colon */
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
     case JSON_EXPECT_VALUE:
 	if (isspace(c))
 	    break;
@@ -1596,57 +1086,46 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 	    /* couldn't recognize start of value literal */
 	    return character_pushback(lexer, GROUND_STATE);
 	break;
-    case JSON_NUMBER:
-	/*
-	 * Will recognize some ill-formed numeric literals.
-	 * Should be OK as we're already three stages deep inside
-	 * JSON recognition; odds that we'll actually see an
-	 * ill-formed literal are quite low. and the worst
-	 * possible result if it happens is our JSON parser will
-	 * quietly chuck out the object.
-	 */
-	if (strchr("1234567890.eE+-", c) == NULL) {
-	    return character_pushback(lexer, JSON_END_VALUE);
-	}
-	break;
-    case JSON_SPECIAL:
-	if (strchr("truefalsnil", c) == NULL)
-	    return character_pushback(lexer, JSON_END_VALUE);
-	break;
-    case JSON_END_VALUE:
-	if (isspace(c))
-	    break;
-	else if (c == ',')
-	    lexer->state = JSON_LEADER;
-	else if (c == '}' || c == ']')
-	    return character_pushback(lexer, JSON_LEADER);
-	else
-	    /* trailing garbage after JSON value */
-	    return character_pushback(lexer, GROUND_STATE);
-	break;
 #endif /* PASSTHROUGH_ENABLE */
-#ifdef STASH_ENABLE
-    case STASH_RECOGNIZED:
-	if (c == '$')
-	    lexer->state = NMEA_DOLLAR;
-	else
-	    return character_pushback(lexer, GROUND_STATE);
+    default:
+	/* the states packetgen.py tabulated */
+	if (0 != packet_row[lexer->state]) {
+	    unsigned int next =
+		packet_table[packet_row[lexer->state]][packet_class[c]];
+
+	    if (0 != (next & PACKET_REREAD))
+		return character_pushback(lexer, next & ~PACKET_REREAD);
+	    if (0 != (next & PACKET_BACK))
+		(void) character_pushback(lexer, next & ~PACKET_BACK);
+	    else
+		lexer->state = next;
+	}
 	break;
-#endif /* STASH_ENABLE */
     }
 
     return true;	/* no pushback */
 }
 
 static void packet_accept(struct gps_lexer_t *lexer, int packet_type)
-/* packet grab succeeded, move to output buffer */
+/* packet grab succeeded, point the output buffer at it */
 {
     size_t packetlen = lexer->inbufptr - lexer->inbuffer;
 
-    if (packetlen < sizeof(lexer->outbuffer)) {
-	memcpy(lexer->outbuffer, lexer->inbuffer, packetlen);
+    if (packetlen < sizeof(lexer->outbuf)) {
+	/*
+	 * Drivers parse textual packets as C strings, so those get a
+	 * terminated copy.  Binary packets are used where they lie; the
+	 * input window only slides past them until the next read.
+	 */
+	if (COMMENT_PACKET == packet_type || BAD_PACKET == packet_type
+	    || TEXTUAL_PACKET_TYPE(packet_type)) {
+	    memcpy(lexer->outbuf, lexer->inbuffer, packetlen);
+	    lexer->outbuf[packetlen] = '\0';
+	    lexer->outbuffer = lexer->outbuf;
+	} else
+	    lexer->outbuffer = lexer->inbuffer;
+	lexer->packet = lexer->inbuffer;
 	lexer->outbuflen = packetlen;
-	lexer->outbuffer[packetlen] = '\0';
 	lexer->type = packet_type;
 	if (lexer->errout.debug >= LOG_RAW + 1) {
 	    char scratchbuf[MAX_PACKET_LENGTH*4+1];
@@ -1665,17 +1144,17 @@ static void packet_accept(struct gps_lexer_t *lexer, int packet_type)
 }
 
 static void packet_discard(struct gps_lexer_t *lexer)
-/* shift the input buffer to discard all data up to current input pointer */
+/* slide the input window past all data up to current input pointer */
 {
     size_t discard = lexer->inbufptr - lexer->inbuffer;
-    size_t remaining = lexer->inbuflen - discard;
-    lexer->inbufptr = memmove(lexer->inbuffer, lexer->inbufptr, remaining);
-    lexer->inbuflen = remaining;
+
+    lexer->inbuffer = lexer->inbufptr;
+    lexer->inbuflen -= discard;
     if (lexer->errout.debug >= LOG_RAW + 1) {
 	char scratchbuf[MAX_PACKET_LENGTH*4+1];
 	GPSD_LOG(LOG_RAW + 1, &lexer->errout,
 		 "Packet discard of %zu, chars remaining is %zu = %s\n",
-		 discard, remaining,
+		 discard, lexer->inbuflen,
 		 gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
 				    (char *)lexer->inbuffer, lexer->inbuflen));
     }
@@ -1703,14 +1182,21 @@ static void packet_stash(struct gps_lexer_t *lexer)
 static void packet_unstash(struct gps_lexer_t *lexer)
 /* return stash to start of input buffer */
 {
-    size_t available = sizeof(lexer->inbuffer) - lexer->inbuflen;
+    size_t available = sizeof(lexer->inbuf) - lexer->inbuflen;
     size_t stashlen = lexer->stashbuflen;
 
     if (stashlen <= available) {
-	memmove(lexer->inbuffer + stashlen, lexer->inbuffer, lexer->inbuflen);
+	/* widen the window backwards, sliding it forward first if need be */
+	if ((size_t)(lexer->inbuffer - lexer->inbuf) < stashlen) {
+	    memmove(lexer->inbuf + stashlen, lexer->inbuffer, lexer->inbuflen);
+	    lexer->inbuffer = lexer->inbuf + stashlen;
+	}
+	lexer->inbufptr = lexer->inbuffer -= stashlen;
 	memcpy(lexer->inbuffer, lexer->stashbuffer, stashlen);
 	lexer->inbuflen += stashlen;
 	lexer->stashbuflen = 0;
+	/* that may land on the packet just accepted; it's textual, view the copy */
+	lexer->packet = lexer->outbuffer;
 	if (lexer->errout.debug >= LOG_RAW+1) {
 	    char scratchbuf[MAX_PACKET_LENGTH*4+1];
 	    GPSD_LOG(LOG_RAW + 1, &lexer->errout,
@@ -1741,17 +1227,156 @@ void lexer_init(struct gps_lexer_t *lexer)
 #endif /* PASSTHROUGH_ENABLE */
     lexer->start_time.tv_sec = 0;
     lexer->start_time.tv_nsec = 0;
+    lexer->packet = lexer->outbuffer = lexer->outbuf;
     packet_reset(lexer);
     errout_reset(&lexer->errout);
 }
 
+/*
+ * Every byte that can take the machine out of GROUND_STATE.  Keep this
+ * in step with the GROUND_STATE case of nextstate(); any other byte is
+ * thrown away there, so ground_skip() may throw away runs of them
+ * without stepping the machine at all.
+ */
+static const unsigned char ground_leaders[] = {
+    '#',
+#ifdef NMEA0183_ENABLE
+    '$', '!',
+#endif /* NMEA0183_ENABLE */
+#if defined(TNT_ENABLE) || defined(GARMINTXT_ENABLE) || defined(ONCORE_ENABLE)
+    '@',
+#endif
+#if defined(SIRF_ENABLE) || defined(SKYTRAQ_ENABLE)
+    0xa0,
+#endif /* SIRF_ENABLE || SKYTRAQ_ENABLE */
+#ifdef SUPERSTAR2_ENABLE
+    SOH,
+#endif /* SUPERSTAR2_ENABLE */
+#if defined(TSIP_ENABLE) || defined(EVERMORE_ENABLE) || defined(GARMIN_ENABLE)
+    DLE,
+#endif /* TSIP_ENABLE || EVERMORE_ENABLE || GARMIN_ENABLE */
+#ifdef TRIPMATE_ENABLE
+    'A',
+#endif /* TRIPMATE_ENABLE */
+#ifdef EARTHMATE_ENABLE
+    'E',
+#endif /* EARTHMATE_ENABLE */
+#ifdef ZODIAC_ENABLE
+    0xff,
+#endif /* ZODIAC_ENABLE */
+#ifdef UBLOX_ENABLE
+    0xb5,
+#endif /* UBLOX_ENABLE */
+#ifdef ITRAX_ENABLE
+    '<',
+#endif /* ITRAX_ENABLE */
+#ifdef NAVCOM_ENABLE
+    0x02,
+#endif /* NAVCOM_ENABLE */
+#ifdef GEOSTAR_ENABLE
+    'P',
+#endif /* GEOSTAR_ENABLE */
+#ifdef GREIS_ENABLE
+    'R', '~',
+#endif /* GREIS_ENABLE */
+#ifdef RTCM104V3_ENABLE
+    0xD3,
+#endif /* RTCM104V3_ENABLE */
+#ifdef PASSTHROUGH_ENABLE
+    '{',
+#endif /* PASSTHROUGH_ENABLE */
+};
+
+/*
+ * RTCM2 hunts for sync through every data byte, @ through DEL, seen in
+ * GROUND_STATE, so those must all be stepped through.
+ */
+#ifdef RTCM104V2_ENABLE
+#define ISGPS_DATA(c)	(((c) & 0xc0) == 0x40)
+#else
+#define ISGPS_DATA(c)	false
+#endif /* RTCM104V2_ENABLE */
+
+static size_t ground_skip(const unsigned char *buf, size_t len)
+/* count the leading bytes that GROUND_STATE would only throw away */
+{
+    size_t i = 0;
+
+    /* as in an RTCM2 stream, which is lexed in GROUND_STATE */
+    if (0 < len && ISGPS_DATA(buf[0]))
+	return 0;
+#if defined(__SSE2__)
+    /* sixteen bytes at a time while none of them is a candidate */
+    for (; i + 16 <= len; i += 16) {
+	__m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+	__m128i hit = _mm_setzero_si128();
+	size_t k;
+	int mask;
+
+	for (k = 0; k < sizeof(ground_leaders); k++)
+	    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v,
+				 _mm_set1_epi8((char)ground_leaders[k])));
+#ifdef RTCM104V2_ENABLE
+	hit = _mm_or_si128(hit,
+			   _mm_cmpeq_epi8(_mm_and_si128(v,
+						_mm_set1_epi8((char)0xc0)),
+					  _mm_set1_epi8(0x40)));
+#endif /* RTCM104V2_ENABLE */
+	if (0 != (mask = _mm_movemask_epi8(hit)))
+	    return i + (size_t)__builtin_ctz((unsigned int)mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+	uint8x16_t v = vld1q_u8(buf + i);
+	uint8x16_t hit = vdupq_n_u8(0);
+	size_t k;
+
+	for (k = 0; k < sizeof(ground_leaders); k++)
+	    hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8(ground_leaders[k])));
+#ifdef RTCM104V2_ENABLE
+	hit = vorrq_u8(hit, vceqq_u8(vandq_u8(v, vdupq_n_u8(0xc0)),
+				     vdupq_n_u8(0x40)));
+#endif /* RTCM104V2_ENABLE */
+	if (0 != vmaxvq_u8(hit))
+	    break;		/* the scalar loop finds which one */
+    }
+#endif
+    for (; i < len; i++)
+	if (ISGPS_DATA(buf[i])
+	    || NULL != memchr(ground_leaders, buf[i], sizeof(ground_leaders)))
+	    break;
+    return i;
+}
+
+static void ground_pass(struct gps_lexer_t *lexer)
+/*
+ * In GROUND_STATE, at the start of the input window, discard the run of
+ * bytes that can't start a packet without stepping the machine for each.
+ * Not used when the per-character trace is wanted.
+ */
+{
+    size_t skip = ground_skip(lexer->inbufptr, lexer->inbuflen);
+
+    lexer->inbufptr = lexer->inbuffer += skip;
+    lexer->inbuflen -= skip;
+    lexer->char_counter += skip;
+#ifdef STASH_ENABLE
+    if (0 < skip)
+	lexer->stashbuflen = 0;
+#endif
+}
+
 void packet_parse(struct gps_lexer_t *lexer)
 /* grab a packet from the input buffer */
 {
     lexer->outbuflen = 0;
+    if (lexer->state == GROUND_STATE && lexer->inbufptr == lexer->inbuffer
+	&& lexer->errout.debug < LOG_RAW + 1)
+	ground_pass(lexer);
     while (packet_buffered_input(lexer) > 0) {
 	unsigned char c = *lexer->inbufptr++;
 	unsigned int oldstate = lexer->state;
+
 	if (!nextstate(lexer, c))
 	    continue;
 	GPSD_LOG(LOG_RAW + 2, &lexer->errout,
@@ -1762,6 +1387,8 @@ void packet_parse(struct gps_lexer_t *lexer)
 
 	if (lexer->state == GROUND_STATE) {
 	    character_discard(lexer);
+	    if (lexer->errout.debug < LOG_RAW + 1)
+		ground_pass(lexer);
 	} else if (lexer->state == COMMENT_RECOGNIZED) {
 	    packet_accept(lexer, COMMENT_PACKET);
 	    packet_discard(lexer);
@@ -2504,6 +2131,43 @@ void packet_parse(struct gps_lexer_t *lexer)
 
 #undef getword
 
+struct packet_view_t packet_view(const struct gps_lexer_t *lexer)
+/* view the last packet where it lies, without the copy in outbuffer */
+{
+    struct packet_view_t view;
+
+    view.type = lexer->type;
+    view.data = lexer->packet;
+    view.len = lexer->outbuflen;
+    return view;
+}
+
+size_t packet_room(struct gps_lexer_t *lexer)
+/*
+ * Make room for input after the window and return it.  The window slides
+ * back to the start of the buffer when less than a packet's worth is left
+ * and no more is moved than has been consumed since the last slide, or
+ * when nothing is left at all.  This is the only place unread input is
+ * moved, so it invalidates packet views, and outbuffer when that points
+ * into the input buffer.
+ */
+{
+    size_t front = lexer->inbuffer - lexer->inbuf;
+    size_t room = sizeof(lexer->inbuf) - lexer->inbuflen - front;
+
+    if (0 < front && (0 == room
+		      || (room < MAX_PACKET_LENGTH
+			  && lexer->inbuflen <= front))) {
+	size_t offset = lexer->inbufptr - lexer->inbuffer;
+
+	memmove(lexer->inbuf, lexer->inbuffer, lexer->inbuflen);
+	lexer->inbuffer = lexer->inbuf;
+	lexer->inbufptr = lexer->inbuffer + offset;
+	room += front;
+    }
+    return room;
+}
+
 ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
 /* grab a packet; return -1=>I/O error, 0=>EOF, or a length */
 {
@@ -2512,8 +2176,7 @@ ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
     errno = 0;
     /* O_NONBLOCK set, so this should not block.
      * Best not to block on an unresponsive GNSS receiver */
-    recvd = read(fd, lexer->inbuffer + lexer->inbuflen,
-		 sizeof(lexer->inbuffer) - (lexer->inbuflen));
+    recvd = read(fd, lexer->inbuffer + lexer->inbuflen, packet_room(lexer));
     if (recvd == -1) {
 	if ((errno == EAGAIN) || (errno == EINTR)) {
 	    GPSD_LOG(LOG_RAW + 2, &lexer->errout, "no bytes ready\n");
@@ -2552,7 +2215,7 @@ ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
     packet_parse(lexer);
 
     /* if input buffer is full, discard */
-    if (sizeof(lexer->inbuffer) == (lexer->inbuflen)) {
+    if (sizeof(lexer->inbuf) == (lexer->inbuflen)) {
 	/* coverity[tainted_data] */
 	packet_discard(lexer);
 	lexer->state = GROUND_STATE;
@@ -2593,7 +2256,7 @@ void packet_reset(struct gps_lexer_t *lexer)
     lexer->type = BAD_PACKET;
     lexer->state = GROUND_STATE;
     lexer->inbuflen = 0;
-    lexer->inbufptr = lexer->inbuffer;
+    lexer->inbufptr = lexer->inbuffer = lexer->inbuf;
 #ifdef BINARY_ENABLE
     isgps_init(lexer);
 #endif /* BINARY_ENABLE */
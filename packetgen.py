@@ -0,0 +1,705 @@
+#!/usr/bin/env python
+#
+# This file is Copyright (c) 2020 by the GPSD project
+# SPDX-License-Identifier: BSD-2-clause
+#
+# Never hand-hack what you can generate...
+#
+# This code generates the transition tables the packet lexer in packet.c
+# walks for the states whose next state depends only on the input byte:
+# leaders, trailers, and the bodies of the textual protocols.  States
+# that count lengths, sum checksums or call out to the RTCM2 decoder
+# stay in the hand-written switch in nextstate().
+#
+# Bytes that behave alike in every table, under every configuration,
+# are folded into one class, so each state costs a row of a few dozen
+# entries rather than 256.  Rows and entries carry the same #if guards
+# the switch arms did, so the generated file is config-independent.
+#
+# This code runs compatibly under Python 2 and 3.x for x >= 2.
+# Preserve this property!
+from __future__ import absolute_import, print_function, division
+
+import sys
+
+
+def chars(s):
+    "The byte values in a string."
+    return set(ord(c) for c in s)
+
+
+def on(*flags):
+    "Guard requiring all of the named build options."
+    return " && ".join("defined(%s_ENABLE)" % f for f in flags)
+
+
+def anyof(*flags):
+    "Guard requiring any of the named build options."
+    return "(" + " || ".join("defined(%s_ENABLE)" % f for f in flags) + ")"
+
+
+# Character classes, as <ctype.h> has them in the C locale
+ALL = set(range(256))
+ASCII = set(range(0x80))
+PRINT = set(range(0x20, 0x7f))
+UPPER = set(range(ord('A'), ord('Z') + 1))
+ALPHA = UPPER | set(range(ord('a'), ord('z') + 1))
+SPACE = chars(" \t\n\v\f\r")
+NONPRINT = ALL - PRINT
+
+
+def back(state):
+    "Push the byte back, drop to state, but report the step taken."
+    return ("PACKET_BACK", state)
+
+
+def reread(state):
+    "Push the byte back and read it again in state."
+    return ("PACKET_REREAD", state)
+
+
+#
+# Here is the information that makes it all work.
+#
+# Notes on the fields:
+# states: the lexer states sharing this row
+# guard: #if condition under which the states exist in nextstate()
+# moves: (bytes, action[, guard]) tried in order, first match wins;
+#        a move with a guard is skipped when the guard is false
+# else: action for bytes no move matched; None stays in the state
+#
+# An action is a state name to step to, or back()/reread() of one.
+#
+
+NMEA = on("NMEA0183")
+REREAD = reread("GROUND_STATE")
+BACK = back("GROUND_STATE")
+
+packet_specs = (
+    {
+        "states": ("COMMENT_BODY",),
+        "moves": (
+            (chars("\n"), "COMMENT_RECOGNIZED"),
+            (NONPRINT, REREAD),
+        ),
+    },
+    {
+        "states": ("NMEA_DOLLAR",),
+        "guard": NMEA,
+        "moves": (
+            (chars("G"), "NMEA_PUB_LEAD"),
+            (chars("P"), "NMEA_VENDOR_LEAD"),     # vendor sentence
+            (chars("I"), "SEATALK_LEAD_1"),       # Seatalk
+            (chars("W"), "WEATHER_LEAD_1"),       # Weather instrument
+            (chars("H"), "HEADCOMP_LEAD_1"),      # Heading/compass
+            (chars("T"), "TURN_LEAD_1"),          # Turn indicator
+            (chars("A"), "SIRF_ACK_LEAD_1"),      # SiRF Ack
+            (chars("E"), "ECDIS_LEAD_1"),         # ECDIS
+            (chars("S"), "SOUNDER_LEAD_1"),
+            (chars("Y"), "TRANSDUCER_LEAD_1"),
+            (chars("B"), "BEIDOU_LEAD_1"),
+            (chars("Q"), "QZSS_LEAD_1"),
+            # $OHPR, and $C? which may never be used
+            (chars("CO"), "NMEA_LEADER_END", on("OCEANSERVER")),
+        ),
+        "else": BACK,
+    },
+    {
+        # $GP == GPS, $GL = GLONASS only, $GN = mixed GPS and GLONASS,
+        # according to NMEA (IEIC 61162-1) DRAFT 02/06/2009.
+        # We have a log from China with a Beidou device using $GB
+        # rather than $BD.
+        "states": ("NMEA_PUB_LEAD",),
+        "guard": NMEA,
+        "moves": (
+            (chars("BPNLA"), "NMEA_LEADER_END"),
+        ),
+        "else": BACK,
+    },
+    # Without the $PASHR states, DLE in a $PASHR can fool the
+    # sniffer into thinking it sees a TSIP packet.  Hilarity ensues.
+    {
+        "states": ("NMEA_VENDOR_LEAD",),
+        "guard": NMEA,
+        "moves": (
+            (chars("A"), "NMEA_PASHR_A"),
+            (ALPHA, "NMEA_LEADER_END"),
+        ),
+        "else": BACK,
+    },
+    {
+        "states": ("NMEA_PASHR_A",),
+        "guard": NMEA,
+        "moves": (
+            (chars("S"), "NMEA_PASHR_S"),
+            (ALPHA, "NMEA_LEADER_END"),
+        ),
+        "else": BACK,
+    },
+    {
+        "states": ("NMEA_PASHR_S",),
+        "guard": NMEA,
+        "moves": (
+            (chars("H"), "NMEA_PASHR_H"),
+            (ALPHA, "NMEA_LEADER_END"),
+        ),
+        "else": BACK,
+    },
+    {
+        "states": ("NMEA_PASHR_H",),
+        "guard": NMEA,
+        "moves": (
+            (chars("R"), "NMEA_BINARY_BODY"),
+            (ALPHA, "NMEA_LEADER_END"),
+        ),
+        "else": BACK,
+    },
+    {
+        "states": ("NMEA_BINARY_BODY",),
+        "guard": NMEA,
+        "moves": (
+            (chars("\r"), "NMEA_BINARY_CR"),
+        ),
+    },
+    {
+        "states": ("NMEA_BINARY_CR",),
+        "guard": NMEA,
+        "moves": (
+            (chars("\n"), "NMEA_BINARY_NL"),
+        ),
+        "else": "NMEA_BINARY_BODY",
+    },
+    {
+        "states": ("NMEA_BINARY_NL",),
+        "guard": NMEA,
+        "moves": (
+            (chars("$"), back("NMEA_RECOGNIZED")),
+        ),
+        "else": "NMEA_BINARY_BODY",
+    },
+    {
+        "states": ("NMEA_BANG",),
+        "guard": NMEA,
+        "moves": (
+            (chars("A"), "AIS_LEAD_1"),
+            (chars("B"), "AIS_LEAD_ALT1"),
+            (chars("S"), "AIS_LEAD_ALT3"),
+        ),
+        "else": REREAD,
+    },
+    {
+        # the NUL is strchr()'s terminator, which it matches too
+        "states": ("AIS_LEAD_1",),
+        "guard": NMEA,
+        "moves": (
+            (chars("BDINRSTX\0"), "AIS_LEAD_2"),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("AIS_LEAD_2", "AIS_LEAD_ALT2", "AIS_LEAD_ALT4"),
+        "guard": NMEA,
+        "moves": (
+            (ALPHA, "NMEA_LEADER_END"),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("AIS_LEAD_ALT1",),
+        "guard": NMEA,
+        "moves": (
+            (chars("S"), "AIS_LEAD_ALT2"),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("AIS_LEAD_ALT3",),
+        "guard": NMEA,
+        "moves": (
+            (chars("A"), "AIS_LEAD_ALT4"),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("AT1_LEADER",),
+        "guard": NMEA + " && " + anyof("TNT", "GARMINTXT", "ONCORE"),
+        "moves": (
+            (chars("@"), "ONCORE_AT2", on("ONCORE")),
+            # TNT has similar structure to NMEA packet, '*' before
+            # optional checksum ends the packet.  Since '*' cannot be
+            # received from GARMIN working in TEXT mode, use this
+            # difference to tell that this is not GARMIN TEXT packet,
+            # could be TNT.
+            (chars("*"), "NMEA_LEADER_END", on("TNT")),
+            # stay in this state, next character should be '\n'
+            (chars("\r"), "AT1_LEADER", on("GARMINTXT")),
+            (chars("\n"), "GTXT_RECOGNIZED", on("GARMINTXT")),
+            (NONPRINT, REREAD),
+        ),
+    },
+    {
+        "states": ("NMEA_LEADER_END",),
+        "guard": NMEA,
+        "moves": (
+            (chars("\r"), "NMEA_CR"),
+            # not strictly correct, but helps for interpreting logfiles
+            (chars("\n"), "NMEA_RECOGNIZED"),
+            (chars("$"), back("STASH_RECOGNIZED"), on("STASH")),
+            (chars("$"), BACK),
+            (NONPRINT, BACK),
+        ),
+    },
+    {
+        # There's a GPS called a Jackson Labs Firefly-1a that emits
+        # \r\r\n at the end of each sentence.  Don't be confused by this.
+        "states": ("NMEA_CR",),
+        "guard": NMEA,
+        "moves": (
+            (chars("\n"), "NMEA_RECOGNIZED"),
+            (chars("\r"), "NMEA_CR"),
+        ),
+        "else": BACK,
+    },
+    {
+        "states": ("NMEA_RECOGNIZED",),
+        "guard": NMEA,
+        "moves": (
+            (chars("#"), "COMMENT_BODY"),
+            (chars("$"), "NMEA_DOLLAR"),
+            (chars("!"), "NMEA_BANG"),
+            # LEA-5H can and will output NMEA and UBX back to back
+            (set([0xb5]), "UBX_LEADER_1", on("UBLOX")),
+            (chars("{"), reread("JSON_LEADER"), on("PASSTHROUGH")),
+        ),
+        "else": REREAD,
+    },
+    {
+        # II or IN are accepted
+        "states": ("SEATALK_LEAD_1",),
+        "guard": NMEA,
+        "moves": ((chars("IN"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        # Weather instrument and turn indicator leaders
+        "states": ("WEATHER_LEAD_1", "TURN_LEAD_1"),
+        "guard": NMEA,
+        "moves": ((chars("I"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        # Heading/compass and ECDIS leaders
+        "states": ("HEADCOMP_LEAD_1", "ECDIS_LEAD_1"),
+        "guard": NMEA,
+        "moves": ((chars("C"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SOUNDER_LEAD_1",),
+        "guard": NMEA,
+        "moves": (
+            (chars("D"), "NMEA_LEADER_END"),      # Depth sounder
+            (chars("T"), "NMEA_LEADER_END", on("SKYTRAQ")),   # $STI
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("TRANSDUCER_LEAD_1",),
+        "guard": NMEA,
+        "moves": ((chars("X"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("BEIDOU_LEAD_1",),
+        "guard": NMEA,
+        "moves": ((chars("D"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("QZSS_LEAD_1",),
+        "guard": NMEA,
+        "moves": ((chars("Z"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SIRF_ACK_LEAD_1",),
+        "guard": NMEA,
+        "moves": (
+            (chars("c"), "SIRF_ACK_LEAD_2"),
+            (chars("I"), "AIS_LEAD_2"),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("SIRF_ACK_LEAD_2",),
+        "guard": NMEA,
+        "moves": ((chars("k"), "NMEA_LEADER_END"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SIRF_LEADER_1",),
+        "guard": anyof("SIRF", "SKYTRAQ"),
+        "moves": (
+            (set([0xa2]), "SIRF_LEADER_2", on("SIRF")),
+            (set([0xa1]), "SKY_LEADER_2", on("SKYTRAQ")),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("SIRF_DELIVERED",),
+        "guard": on("SIRF"),
+        "moves": ((set([0xb0]), "SIRF_TRAILER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SIRF_TRAILER_1",),
+        "guard": on("SIRF"),
+        "moves": ((set([0xb3]), "SIRF_RECOGNIZED"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SIRF_RECOGNIZED",),
+        "guard": on("SIRF"),
+        "moves": ((set([0xa0]), "SIRF_LEADER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SKY_CSUM",),
+        "guard": on("SKYTRAQ"),
+        "moves": ((set([0x0d]), "SKY_TRAILER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SKY_TRAILER_1",),
+        "guard": on("SKYTRAQ"),
+        "moves": ((set([0x0a]), "SKY_RECOGNIZED"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SKY_RECOGNIZED",),
+        "guard": on("SKYTRAQ"),
+        "moves": ((set([0xa0]), "SIRF_LEADER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("SUPERSTAR2_RECOGNIZED",),
+        "guard": on("SUPERSTAR2"),
+        "moves": ((set([0x01]), "SUPERSTAR2_LEADER"),),     # SOH
+        "else": REREAD,
+    },
+    {
+        "states": ("ONCORE_CHECKSUM",),
+        "guard": on("ONCORE"),
+        "moves": ((chars("\r"), "ONCORE_CR"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("ONCORE_CR",),
+        "guard": on("ONCORE"),
+        "moves": ((chars("\n"), "ONCORE_RECOGNIZED"),),
+        "else": "ONCORE_PAYLOAD",
+    },
+    {
+        "states": ("ONCORE_RECOGNIZED",),
+        "guard": on("ONCORE"),
+        "moves": ((chars("@"), "AT1_LEADER"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("NAVCOM_LEADER_1",),
+        "guard": on("NAVCOM") + " && " + anyof("TSIP", "EVERMORE", "GARMIN"),
+        "moves": ((set([0x99]), "NAVCOM_LEADER_2"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("NAVCOM_LEADER_2",),
+        "guard": on("NAVCOM") + " && " + anyof("TSIP", "EVERMORE", "GARMIN"),
+        "moves": ((set([0x66]), "NAVCOM_LEADER_3"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("NAVCOM_CSUM",),
+        "guard": on("NAVCOM") + " && " + anyof("TSIP", "EVERMORE", "GARMIN"),
+        "moves": ((set([0x03]), "NAVCOM_RECOGNIZED"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("NAVCOM_RECOGNIZED",),
+        "guard": on("NAVCOM") + " && " + anyof("TSIP", "EVERMORE", "GARMIN"),
+        "moves": ((set([0x02]), "NAVCOM_LEADER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("ZODIAC_EXPECTED", "ZODIAC_RECOGNIZED"),
+        "guard": on("ZODIAC"),
+        "moves": ((set([0xff]), "ZODIAC_LEADER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("ZODIAC_LEADER_1",),
+        "guard": on("ZODIAC"),
+        "moves": ((set([0x81]), "ZODIAC_LEADER_2"),),
+        "else": BACK,
+    },
+    {
+        "states": ("UBX_LEADER_1",),
+        "guard": on("UBLOX"),
+        "moves": ((set([0x62]), "UBX_LEADER_2"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("UBX_RECOGNIZED",),
+        "guard": on("UBLOX"),
+        "moves": (
+            (set([0xb5]), "UBX_LEADER_1"),
+            # LEA-5H can and will output NMEA and UBX back to back
+            (chars("$"), "NMEA_DOLLAR", NMEA),
+            (chars("{"), reread("JSON_LEADER"), on("PASSTHROUGH")),
+        ),
+        "else": REREAD,
+    },
+    {
+        "states": ("EVERMORE_LEADER_1",),
+        "guard": on("EVERMORE"),
+        "moves": ((set([0x02]), "EVERMORE_LEADER_2"),),     # STX
+        "else": REREAD,
+    },
+    {
+        "states": ("EVERMORE_RECOGNIZED",),
+        "guard": on("EVERMORE"),
+        "moves": ((set([0x10]), "EVERMORE_LEADER_1"),),     # DLE
+        "else": REREAD,
+    },
+    {
+        "states": ("ITALK_LEADER_1",),
+        "guard": on("ITRAX"),
+        "moves": ((chars("!"), "ITALK_LEADER_2"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("ITALK_DELIVERED",),
+        "guard": on("ITRAX"),
+        "moves": ((chars(">"), "ITALK_RECOGNIZED"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("ITALK_RECOGNIZED",),
+        "guard": on("ITRAX"),
+        "moves": ((chars("<"), "ITALK_LEADER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("GEOSTAR_LEADER_1",),
+        "guard": on("GEOSTAR"),
+        "moves": ((chars("S"), "GEOSTAR_LEADER_2"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("GEOSTAR_LEADER_2",),
+        "guard": on("GEOSTAR"),
+        "moves": ((chars("G"), "GEOSTAR_LEADER_3"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("GEOSTAR_LEADER_3",),
+        "guard": on("GEOSTAR"),
+        "moves": ((chars("G"), "GEOSTAR_LEADER_4"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("GEOSTAR_RECOGNIZED",),
+        "guard": on("GEOSTAR"),
+        "moves": ((chars("P"), "GEOSTAR_LEADER_1"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("GREIS_REPLY_1",),
+        "guard": on("GREIS"),
+        "moves": ((chars("E"), "GREIS_REPLY_2"),),
+        "else": REREAD,
+    },
+    {
+        "states": ("GREIS_ID_1",),
+        "guard": on("GREIS"),
+        "moves": ((ASCII, "GREIS_ID_2"),),
+        "else": REREAD,
+    },
+    {
+        # Don't go to TSIP_LEADER state -- TSIP packets aren't
+        # checksummed, so false positives are easy.  We might be
+        # looking at another DLE-stuffed protocol like EverMore
+        # or Garmin streaming binary.
+        "states": ("TSIP_RECOGNIZED",),
+        "guard": on("TSIP"),
+        "moves": ((set([0x10]), "DLE_LEADER"),),            # DLE
+        "else": REREAD,
+    },
+    {
+        "states": ("JSON_END_ATTRIBUTE",),
+        "guard": on("PASSTHROUGH"),
+        "moves": (
+            (SPACE, "JSON_END_ATTRIBUTE"),
+            (chars(":"), "JSON_EXPECT_VALUE"),
+        ),
+        # saw something other than value start after colon
+        "else": REREAD,
+    },
+    {
+        # Will recognize some ill-formed numeric literals.  The NUL
+        # is strchr()'s terminator, which it matches too.
+        "states": ("JSON_NUMBER",),
+        "guard": on("PASSTHROUGH"),
+        "moves": ((chars("1234567890.eE+-\0"), "JSON_NUMBER"),),
+        "else": reread("JSON_END_VALUE"),
+    },
+    {
+        "states": ("JSON_SPECIAL",),
+        "guard": on("PASSTHROUGH"),
+        "moves": ((chars("truefalsnil\0"), "JSON_SPECIAL"),),
+        "else": reread("JSON_END_VALUE"),
+    },
+    {
+        "states": ("JSON_END_VALUE",),
+        "guard": on("PASSTHROUGH"),
+        "moves": (
+            (SPACE, "JSON_END_VALUE"),
+            (chars(","), "JSON_LEADER"),
+            (chars("}]"), reread("JSON_LEADER")),
+        ),
+        # trailing garbage after JSON value
+        "else": REREAD,
+    },
+    {
+        "states": ("STASH_RECOGNIZED",),
+        "guard": on("STASH"),
+        "moves": ((chars("$"), "NMEA_DOLLAR"),),
+        "else": REREAD,
+    },
+)
+
+
+def choices(spec, byte):
+    "The (guard, action) candidates for a byte in one row, in order."
+    out = []
+    for move in spec["moves"]:
+        if byte in move[0]:
+            guard = move[2] if len(move) > 2 else None
+            out.append((guard, move[1]))
+            if guard is None:
+                return tuple(out)
+    # None means stay put, which is a step to the row's own state
+    assert "else" in spec or len(spec["states"]) == 1
+    out.append((None, spec.get("else") or spec["states"][0]))
+    return tuple(out)
+
+
+def cvalue(action):
+    "C initializer for an action."
+    if isinstance(action, tuple):
+        return "%s|%s" % action
+    return action
+
+
+def describe(byte):
+    "Comment text naming a byte."
+    if 0x20 < byte < 0x7f and byte not in (ord("*"), ord("/")):
+        return "'%c'" % chr(byte)
+    return "0x%02x" % byte
+
+
+def reguard(old, new):
+    "Move from one row guard to the next, sharing runs of the same one."
+    if old != new:
+        if old:
+            print("#endif")
+        if new:
+            print("#if %s" % new)
+    return new
+
+
+def generate(specs):
+    "Emit the byte classes, state-to-row map, and transition rows."
+    signatures = {}
+    classes = []            # byte -> class
+    members = []            # class -> bytes
+    for byte in range(256):
+        sig = tuple(choices(spec, byte) for spec in specs)
+        if sig not in signatures:
+            signatures[sig] = len(members)
+            members.append([])
+        classes.append(signatures[sig])
+        members[signatures[sig]].append(byte)
+
+    print("#define PACKET_BACK\t0x4000\t/* push back, but report a step */")
+    print("#define PACKET_REREAD\t0x8000\t/* push back and read it again */")
+    print("#define PACKET_CLASSES\t%d" % len(members))
+    print()
+    print("/* byte classes; bytes in a class behave alike in every row */")
+    print("static const unsigned char packet_class[256] = {")
+    for i in range(0, 256, 16):
+        print("    " + ", ".join("%2d" % c for c in classes[i:i + 16]) + ",")
+    print("};")
+    print()
+
+    print("/* row of packet_table for each tabled state, 0 for the rest */")
+    print("static const unsigned char packet_row[PACKET_STATES] = {")
+    guard = None
+    for (row, spec) in enumerate(specs, 1):
+        guard = reguard(guard, spec.get("guard"))
+        for state in spec["states"]:
+            print("    [%s] = %d," % (state, row))
+    reguard(guard, None)
+    print("};")
+    print()
+
+    print("static const unsigned short "
+          "packet_table[%d][PACKET_CLASSES] = {" % (len(specs) + 1))
+    guard = None
+    for (row, spec) in enumerate(specs, 1):
+        guard = reguard(guard, spec.get("guard"))
+        print("    /* %s */" % ", ".join(spec["states"]))
+        print("    [%d] = {" % row)
+        line = ""
+        for (cls, bytes_) in enumerate(members):
+            cands = choices(spec, bytes_[0])
+            if len(cands) == 1:
+                item = cvalue(cands[0][1]) + ","
+                if len(line) + len(item) + 1 > 70:
+                    print("\t" + line)
+                    line = ""
+                line += (" " if line else "") + item
+                continue
+            if line:
+                print("\t" + line)
+                line = ""
+            for (i, (cond, action)) in enumerate(cands):
+                if cond is None:
+                    print("#else")
+                else:
+                    print("#%s %s" % ("if" if i == 0 else "elif", cond))
+                print("\t%s,\t/* %s */" % (cvalue(action),
+                                          describe(bytes_[0])))
+            print("#endif")
+        if line:
+            print("\t" + line)
+        print("    },")
+    reguard(guard, None)
+    print("};")
+
+
+if __name__ == '__main__':
+    if len(sys.argv) > 1:
+        print("usage: packetgen.py >packet_table.i", file=sys.stderr)
+        raise SystemExit(1)
+
+    print("""/*
+ * This is code generated by packetgen.py. Do not hand-hack it!
+ */
+""")
+    generate(packet_specs)
+    print("""
+/* Generated code ends. */""")
+# The following sets edit modes for GNU EMACS
+# Local Variables:
+# mode:python
+# End:
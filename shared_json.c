@@ -19,8 +19,10 @@ PERMISSIONS
 
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>       /* for offsetof() */
 
 #include "gpsd.h"
+#include "bits.h"
 #ifdef SOCKET_EXPORT_ENABLE
 #include "gps_json.h"
 #include "timespec.h"
@@ -92,6 +94,10 @@ int json_watch_read(const char *buf,
 		    const char **endptr)
 {
     bool dummy_pps_flag;
+    char *fieldptrs[GPS_FIELDS_MAX / 2];
+    char fieldstore[GPS_FIELDS_MAX];
+    int nfields = 0, i;
+    double maxrate;
     /* *INDENT-OFF* */
     struct json_attr_t chanconfig_attrs[] = {
 	{"class",          t_check,    .dflt.check = "WATCH"},
@@ -108,6 +114,23 @@ int json_watch_read(const char *buf,
 	{"timing",         t_boolean,  .addr.boolean = &ccp->timing},
 	{"split24",        t_boolean,  .addr.boolean = &ccp->split24},
 	{"pps",            t_boolean,  .addr.boolean = &ccp->pps},
+	{"binary",         t_boolean,  .addr.boolean = &ccp->binary},
+	{"delta",          t_boolean,  .addr.boolean = &ccp->delta},
+	{"fields",         t_array,    .addr.array.element_type = t_string,
+	                               .addr.array.arr.strings.ptrs = fieldptrs,
+	                               .addr.array.arr.strings.store = fieldstore,
+	                               .addr.array.arr.strings.storelen =
+	                                   sizeof(fieldstore),
+	                               .addr.array.count = &nfields,
+	                               .addr.array.maxlen = NITEMS(fieldptrs)},
+	{"interval",       t_real,     .addr.real = &ccp->interval,
+	                                  .dflt.real = 0},
+	{"maxrate",        t_real,     .addr.real = &maxrate,
+	                                  .dflt.real = 0},
+	{"aisinterval",    t_real,     .addr.real = &ccp->aisinterval,
+	                                  .dflt.real = 0},
+	{"compress",       t_boolean,  .addr.boolean = &ccp->compress,
+	                                  .nodefault = true},
 	{"device",         t_string,   .addr.string = ccp->devpath,
 	                                  .len = sizeof(ccp->devpath)},
 	{"remote",         t_string,   .addr.string = ccp->remote,
@@ -120,9 +143,82 @@ int json_watch_read(const char *buf,
     int status;
 
     status = json_read_object(buf, chanconfig_attrs, endptr);
+    /* maxrate is the interval upside down */
+    if (0 < maxrate && 0 >= ccp->interval)
+	ccp->interval = 1 / maxrate;
+    /* the projection is kept as the names joined by commas */
+    ccp->fields[0] = '\0';
+    for (i = 0; 0 == status && i < nfields; i++) {
+	if ('\0' == fieldptrs[i][0] || NULL != strpbrk(fieldptrs[i], ",\"\\"))
+	    continue;		/* can't name a member gpsd sends */
+	if (strlen(ccp->fields) + strlen(fieldptrs[i]) + 2
+	    > sizeof(ccp->fields))
+	    return JSON_ERR_STRLONG;
+	if ('\0' != ccp->fields[0])
+	    (void)strlcat(ccp->fields, ",", sizeof(ccp->fields));
+	(void)strlcat(ccp->fields, fieldptrs[i], sizeof(ccp->fields));
+    }
     return status;
 }
 
+#define FIX_FIELD(f, mode)	{offsetof(struct gps_fix_t, f), mode}
+/* same fields, and the same mode gating, as json_tpv_dump() */
+const struct binary_field_t binary_tpv_fields[BINARY_TPV_FIELDS] = {
+    FIX_FIELD(ept, MODE_NOT_SEEN),
+    FIX_FIELD(latitude, MODE_2D),
+    FIX_FIELD(longitude, MODE_2D),
+    FIX_FIELD(altHAE, MODE_2D),
+    FIX_FIELD(altMSL, MODE_2D),
+    FIX_FIELD(epx, MODE_2D),
+    FIX_FIELD(epy, MODE_2D),
+    FIX_FIELD(epv, MODE_2D),
+    FIX_FIELD(track, MODE_2D),
+    FIX_FIELD(magnetic_track, MODE_2D),
+    FIX_FIELD(magnetic_var, MODE_2D),
+    FIX_FIELD(speed, MODE_2D),
+    FIX_FIELD(climb, MODE_3D),
+    FIX_FIELD(epd, MODE_2D),
+    FIX_FIELD(eps, MODE_2D),
+    FIX_FIELD(epc, MODE_3D),
+    FIX_FIELD(ecef.x, MODE_3D),
+    FIX_FIELD(ecef.y, MODE_3D),
+    FIX_FIELD(ecef.z, MODE_3D),
+    FIX_FIELD(ecef.vx, MODE_3D),
+    FIX_FIELD(ecef.vy, MODE_3D),
+    FIX_FIELD(ecef.vz, MODE_3D),
+    FIX_FIELD(ecef.pAcc, MODE_3D),
+    FIX_FIELD(ecef.vAcc, MODE_3D),
+    FIX_FIELD(NED.relPosN, MODE_3D),
+    FIX_FIELD(NED.relPosE, MODE_3D),
+    FIX_FIELD(NED.relPosD, MODE_3D),
+    FIX_FIELD(NED.velN, MODE_3D),
+    FIX_FIELD(NED.velE, MODE_3D),
+    FIX_FIELD(NED.velD, MODE_3D),
+    FIX_FIELD(geoid_sep, MODE_3D),
+    FIX_FIELD(eph, MODE_2D),
+    FIX_FIELD(sep, MODE_2D),
+    FIX_FIELD(depth, MODE_2D),
+    FIX_FIELD(dgps_age, MODE_2D),
+};
+#undef FIX_FIELD
+
+ssize_t binary_record_length(const char *buf, size_t len)
+/* length of the binary record at buf, 0 if incomplete, -1 if not one */
+{
+    size_t pathlen;
+
+    if (0 == len)
+	return 0;
+    if (BINARY_MAGIC != (unsigned char)buf[0])
+	return -1;
+    if (3 > len)
+	return 0;
+    pathlen = (unsigned char)buf[2];
+    if (pathlen + 5 > len)
+	return 0;
+    return (ssize_t)(pathlen + 5 + getleu16(buf, pathlen + 3));
+}
+
 #endif /* SOCKET_EXPORT_ENABLE */
 
 /* shared_json.c ends here */
@@ -9,6 +9,15 @@ won't be able to filter by device, and won't get device activation/deactivation
 notifications.  But both client and daemon will avoid all the marshalling and
 unmarshalling overhead.
 
+   The segment is a ring of the last SHM_RING updates, each guarded by its
+own sequence number, so a reader that wakes late can still take every
+update since the last one it saw, and knows how many it lost if it fell
+more than a ring behind.
+
+   That segment carries the whole of every update from every device.
+Alongside it, each device gets one small segment per record class (fix,
+skyview, raw measurements), written only when that class changes.
+
 PERMISSIONS
    This file is Copyright (c) 2010-2018 by the GPSD project
    SPDX-License-Identifier: BSD-2-clause
@@ -20,12 +29,18 @@ PERMISSIONS
 #ifdef SHM_EXPORT_ENABLE
 
 #include <errno.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/time.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
 
 #include "gpsd.h"
 #include "libgps.h" /* for SHM_PSEUDO_FD */
@@ -81,10 +96,34 @@ static int recreate_segment(key_t shmkey, struct gps_context_t *context, size_t
     return shmid;
 }
 
+static long shm_key(void)
+/* base key of the export segments */
+{
+    return getenv("GPSD_SHM_KEY") ? strtol(getenv("GPSD_SHM_KEY"), NULL, 0) : GPSD_SHM_KEY;
+}
+
+static void shm_wake(volatile unsigned int *head, unsigned int waiters)
+/* wake any readers asleep on a ring's head, which has just moved */
+{
+#ifdef __linux__
+    /*
+     * A reader counts itself in waiters before it checks head and
+     * sleeps, and we check waiters only after moving head, so one of
+     * us always sees the other.  No readers asleep, no system call.
+     */
+    if (0 < waiters)
+	(void)syscall(SYS_futex, (unsigned int *)head,
+		      FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)head;
+    (void)waiters;
+#endif /* __linux__ */
+}
+
 bool shm_acquire(struct gps_context_t *context)
 /* initialize the shared-memory segment to be used for export */
 {
-    long shmkey = getenv("GPSD_SHM_KEY") ? strtol(getenv("GPSD_SHM_KEY"), NULL, 0) : GPSD_SHM_KEY;
+    long shmkey = shm_key();
     int mode = 0666;
     size_t segment_size = sizeof(struct shmexport_t);
 
@@ -110,6 +149,7 @@ bool shm_acquire(struct gps_context_t *context)
 	return false;
     }
     context->shmid = shmid;
+    ((volatile struct shmexport_t *)context->shmexport)->magic = SHM_MAGIC;
 
     GPSD_LOG(LOG_PROG, &context->errout,
 	     "shmat() for SHM export succeeded, segment %d\n", shmid);
@@ -139,36 +179,196 @@ void shm_update(struct gps_context_t *context, struct gps_data_t *gpsdata)
 {
     if (context->shmexport != NULL)
     {
-	static int tick;
 	volatile struct shmexport_t *shared = (struct shmexport_t *)context->shmexport;
+	/* carry on from a segment left by an earlier run, for its readers */
+	unsigned int tick = shared->head + 1;
+	volatile struct shmslot_t *slot = &shared->slot[tick % SHM_RING];
 
-	++tick;
 	/*
 	 * Following block of instructions must not be reordered, otherwise
 	 * havoc will ensue.
 	 *
-	 * This is a simple optimistic-concurrency technique.  We write
-	 * the second bookend first, then the data, then the first bookend.
-	 * Reader copies what it sees in normal order; that way, if we
-	 * start to write the segment during the read, the second bookend will
-	 * get clobbered first and the data can be detected as bad.
+	 * This is a seqlock per slot.  The sequence number goes odd before
+	 * the data is touched and even, for this tick, once it is whole.
+	 * A reader checks the number before and after its copy; if they
+	 * differ, or aren't the even number it wanted, it raced us and
+	 * the copy is discarded.  Only then does head move on, so a reader
+	 * never looks for an update that isn't finished.
 	 *
 	 * Of course many architectures, like Intel, make no guarantees
 	 * about the actual memory read or write order into RAM, so this
          * is partly wishful thinking.  Thus the need for the memory_barriers()
          * to enforce the required order.
 	 */
-	shared->bookend2 = tick;
+	slot->seq = 2 * tick - 1;
 	memory_barrier();
-	shared->gpsdata = *gpsdata;
+	slot->gpsdata = *gpsdata;
 	memory_barrier();
 #ifndef USE_QT
-	shared->gpsdata.gps_fd = SHM_PSEUDO_FD;
+	slot->gpsdata.gps_fd = SHM_PSEUDO_FD;
 #else
-	shared->gpsdata.gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
+	slot->gpsdata.gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
 #endif /* USE_QT */
 	memory_barrier();
-	shared->bookend1 = tick;
+	slot->seq = 2 * tick;
+	memory_barrier();
+	shared->head = tick;
+	memory_barrier();
+	shm_wake(&shared->head, shared->waiters);
+    }
+}
+
+/* what rewrites each record class: a whole fix, skyview or epoch */
+static const gps_mask_t class_trigger[SHM_CLASSES] = {
+    [SHM_FIX] = REPORT_IS,
+    [SHM_SKY] = SATELLITE_SET,
+    [SHM_RAW] = RAW_SET,
+};
+
+/* what each record class carries */
+static const gps_mask_t class_mask[SHM_CLASSES] = {
+    [SHM_FIX] = TIME_SET | TIMERR_SET | LATLON_SET | ALTITUDE_SET |
+		SPEED_SET | TRACK_SET | CLIMB_SET | STATUS_SET | MODE_SET |
+		DOP_SET | HERR_SET | VERR_SET | SPEEDERR_SET | TRACKERR_SET |
+		CLIMBERR_SET | ECEF_SET | VECEF_SET | MAGNETIC_TRACK_SET |
+		NED_SET | VNED_SET,
+    [SHM_SKY] = SATELLITE_SET | DOP_SET,
+    [SHM_RAW] = RAW_SET,
+};
+
+static const size_t class_size[SHM_CLASSES] = {
+    [SHM_FIX] = sizeof(struct shmfix_t),
+    [SHM_SKY] = sizeof(struct shmsky_t),
+    [SHM_RAW] = sizeof(struct shmraw_t),
+};
+
+static volatile struct shmdevice_t *device_segment(
+			struct gps_context_t *context,
+			struct gps_device_t *device, int n, int class)
+/* the segment for one class of a device's records, created on first use */
+{
+    long shmkey = SHM_DEVICE_KEY(shm_key(), n, class);
+    size_t segment_size = sizeof(struct shmdevice_t)
+			  + SHM_RING * class_size[class];
+    volatile struct shmdevice_t *shared;
+    int shmid;
+
+    if (NULL != device->shmdevice[class])
+	return device->shmdevice[class];
+
+    shmid = recreate_segment((key_t)shmkey, context, segment_size, 0666);
+    if (-1 == shmid) {
+	GPSD_LOG(LOG_ERROR, &context->errout,
+		 "shmget(0x%lx, %zd, 0666) for %s SHM export failed: %s\n",
+		 shmkey, segment_size, device->gpsdata.dev.path,
+		 strerror(errno));
+	return NULL;
+    }
+    shared = (volatile struct shmdevice_t *)shmat(shmid, 0, 0);
+    if ((int)(long)shared == -1) {
+	GPSD_LOG(LOG_ERROR, &context->errout,
+		 "shmat failed: %s\n", strerror(errno));
+	return NULL;
+    }
+    /* the segment was fresh, or left by a gone device that emptied path */
+    shared->magic = SHM_MAGIC;
+    shared->class = (unsigned int)class;
+    shared->stride = (unsigned int)class_size[class];
+    (void)strlcpy((char *)shared->path, device->gpsdata.dev.path,
+		  sizeof(shared->path));
+    memory_barrier();
+    device->shmdevice[class] = shared;
+    device->shmdeviceid[class] = shmid;
+    GPSD_LOG(LOG_PROG, &context->errout,
+	     "%s: SHM export of class %d on segment %d\n",
+	     device->gpsdata.dev.path, class, shmid);
+    return shared;
+}
+
+void shm_device_update(struct gps_context_t *context,
+		       struct gps_device_t *device, int n, gps_mask_t changed)
+/* export the record classes a change touched to the device's segments */
+{
+    int class;
+
+    if (NULL == context->shmexport)
+	return;			/* SHM export wasn't wanted or didn't work */
+
+    for (class = 0; class < SHM_CLASSES; class++) {
+	volatile struct shmdevice_t *shared;
+	volatile struct shmrecord_t *slot;
+	union {
+	    struct shmrecord_t hdr;
+	    struct shmfix_t fix;
+	    struct shmsky_t sky;
+	    struct shmraw_t raw;
+	} rec;
+	unsigned int tick;
+
+	if (0 == (changed & class_trigger[class])
+	    || NULL == (shared = device_segment(context, device, n, class)))
+	    continue;
+
+	/* build the record off to the side, then copy only its own size */
+	rec.hdr.set = changed & class_mask[class];
+	switch (class) {
+	case SHM_FIX:
+	    rec.fix.status = device->gpsdata.status;
+	    rec.fix.fix = device->gpsdata.fix;
+	    rec.fix.dop = device->gpsdata.dop;
+	    break;
+	case SHM_SKY:
+	    rec.sky.skyview_time = device->gpsdata.skyview_time;
+	    rec.sky.satellites_visible = device->gpsdata.satellites_visible;
+	    rec.sky.satellites_used = device->gpsdata.satellites_used;
+	    rec.sky.dop = device->gpsdata.dop;
+	    (void)memcpy(rec.sky.skyview, device->gpsdata.skyview,
+			 sizeof(rec.sky.skyview));
+	    break;
+	case SHM_RAW:
+	    rec.raw.raw = device->gpsdata.raw;
+	    break;
+	}
+
+	/* the same seqlock as shm_update(), on a slot of this class */
+	tick = shared->head + 1;
+	slot = (volatile struct shmrecord_t *)((volatile char *)(shared + 1)
+				+ (tick % SHM_RING) * class_size[class]);
+	slot->seq = 2 * tick - 1;
+	memory_barrier();
+	(void)memcpy((char *)slot + sizeof(slot->seq),
+		     (char *)&rec + sizeof(rec.hdr.seq),
+		     class_size[class] - sizeof(rec.hdr.seq));
+	memory_barrier();
+	slot->seq = 2 * tick;
+	memory_barrier();
+	shared->head = tick;
+	memory_barrier();
+	shm_wake(&shared->head, shared->waiters);
+    }
+}
+
+void shm_device_release(struct gps_context_t *context,
+			struct gps_device_t *device)
+/* tell readers of a device's segments it has gone, and let them go */
+{
+    int class;
+
+    for (class = 0; class < SHM_CLASSES; class++) {
+	volatile struct shmdevice_t *shared = device->shmdevice[class];
+
+	if (NULL == shared)
+	    continue;
+	shared->path[0] = '\0';
+	memory_barrier();
+	/* wake sleepers so they see the path go; they'll find no update */
+	shm_wake(&shared->head, shared->waiters);
+	if (-1 == shmctl(device->shmdeviceid[class], IPC_RMID, NULL))
+	    GPSD_LOG(LOG_WARN, &context->errout,
+		     "shmctl for IPC_RMID failed, errno = %d (%s)\n",
+		     errno, strerror(errno));
+	(void)shmdt((const void *)shared);
+	device->shmdevice[class] = NULL;
     }
 }
 
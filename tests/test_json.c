@@ -379,6 +379,12 @@ static const struct json_array_t json_array_Real = {
     .count = &realcount,
     .maxlen = sizeof(realstore)/sizeof(realstore[0]),
 };
+
+/* Case 24: SKY delta, merged into case 2's report */
+
+static const char *json_str24 = "{\"class\":\"SKY\",\"delta\":true,"
+    "\"hdop\":1.5,\"satellites\":[{},{\"ss\":41},{},{},{},{},"
+    "{\"ss\":12,\"used\":true}]}";
 #endif /* JSON_MINIMAL */
 
 /* *INDENT-ON* */
@@ -648,7 +654,23 @@ static void jsontest(int i)
 	assert_real("realstore[3]", realstore[3], 0);
 	break;
 
-#define MAXTEST 23
+    case 24:
+	status = libgps_json_unpack(json_str2, &gpsdata, NULL);
+	assert_case(status);
+	status = libgps_json_unpack(json_str24, &gpsdata, NULL);
+	assert_case(status);
+	assert_integer("visible", gpsdata.satellites_visible, 7);
+	assert_integer("used", gpsdata.satellites_used, 7);
+	assert_real("hdop", gpsdata.dop.hdop, 1.5);
+	assert_real("ss[0]", gpsdata.skyview[0].ss, 34);
+	assert_real("ss[1]", gpsdata.skyview[1].ss, 41);
+	assert_integer("PRN[6]", gpsdata.skyview[6].PRN, 21);
+	assert_integer("el[6]", gpsdata.skyview[6].elevation, 10);
+	assert_real("ss[6]", gpsdata.skyview[6].ss, 12);
+	assert_boolean("used[6]", gpsdata.skyview[6].used, true);
+	break;
+
+#define MAXTEST 24
 #endif /* JSON_MINIMAL */
 
     default:
@@ -9,9 +9,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "../gpsd.h"
+#include "../timespec.h"
 
 static int verbose = 0;
 
@@ -280,6 +282,12 @@ static int packet_test(struct map *mp)
 	printf("%2ti: %s test FAILED (data garbled).\n", mp - singletests + 1,
 	       mp->legend);
 	++failure;
+    } else if (memcmp
+	       (mp->test + mp->garbage_offset, packet_view(&lexer).data,
+		packet_view(&lexer).len)) {
+	printf("%2ti: %s test FAILED (view garbled).\n", mp - singletests + 1,
+	       mp->legend);
+	++failure;
     } else
 	printf("%2ti: %s test succeeded.\n", mp - singletests + 1,
 	       mp->legend);
@@ -304,6 +312,84 @@ static void runon_test(struct map *mp)
     } while (st > 0);
 }
 
+static void lexer_throughput(const char *legend,
+			     const unsigned char *data, size_t len)
+/* time the lexer over a buffer the way packet_get() would feed it */
+{
+    struct gps_lexer_t lexer;
+    unsigned long packets = 0;
+    double best = 0;
+    int batch, round;
+    const int batches = 5, rounds = 20;
+
+    /* take the best batch, as the least disturbed by anything else */
+    for (batch = 0; batch < batches; batch++) {
+	timespec_t start, end;
+	double secs;
+
+	packets = 0;
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < rounds; round++) {
+	    size_t fed = 0;
+
+	    lexer_init(&lexer);
+	    for (;;) {
+		size_t room = packet_room(&lexer);
+		size_t n = (len - fed < room) ? len - fed : room;
+
+		memcpy(lexer.inbuffer + lexer.inbuflen, data + fed, n);
+		lexer.inbuflen += n;
+		fed += n;
+		if (0 == n && 0 >= packet_buffered_input(&lexer))
+		    break;
+		packet_parse(&lexer);
+		if (sizeof(lexer.inbuf) == lexer.inbuflen)
+		    packet_reset(&lexer);   /* packet_get() drops it too */
+		if (0 < lexer.outbuflen)
+		    packets++;
+		else if (0 == n)
+		    break;
+	    }
+	}
+	(void)clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = TS_SUB_D(&end, &start);
+	if (0 == batch || secs < best)
+	    best = secs;
+    }
+    (void)printf("%-40s %8zu bytes %6lu packets %8.1f MB/s\n",
+		 legend, len, packets / rounds,
+		 (double)len * rounds / best / 1e6);
+}
+
+static int throughput_test(int argc, char *argv[])
+/* lexer throughput over captures, and over line noise */
+{
+    static unsigned char data[1 << 20];
+    unsigned int seed = 1;
+    size_t len;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+	FILE *fp = fopen(argv[i], "rb");
+
+	if (NULL == fp) {
+	    (void)fprintf(stderr, "test_packet: can't open %s\n", argv[i]);
+	    return EXIT_FAILURE;
+	}
+	len = fread(data, 1, sizeof(data), fp);
+	(void)fclose(fp);
+	lexer_throughput(argv[i], data, len);
+    }
+
+    /* a fixed pseudo-random stream, as from a bad baud rate */
+    for (len = 0; len < sizeof(data); len++) {
+	seed = seed * 1103515245 + 12345;
+	data[len] = (unsigned char)(seed >> 16);
+    }
+    lexer_throughput("(line noise)", data, len);
+    return EXIT_SUCCESS;
+}
+
 static int property_check(void)
 {
     const struct gps_type_t **dp;
@@ -376,8 +462,11 @@ int main(int argc, char *argv[])
     int option, singletest = 0;
 
     verbose = 0;
-    while ((option = getopt(argc, argv, "ce:t:v:")) != -1) {
+    while ((option = getopt(argc, argv, "bce:t:v:")) != -1) {
 	switch (option) {
+	case 'b':
+	    /* benchmark: tests/test_packet -b test/daemon/FILE.log ... */
+	    exit(throughput_test(argc - optind, argv + optind));
 	case 'c':
 	    exit(property_check());
 	case 'e':
@@ -0,0 +1,190 @@
+/****************************************************************************
+
+NAME
+   udpexport.c - UDP multicast/broadcast export from the daemon
+
+DESCRIPTION
+   JSON-over-sockets costs one write per report per watcher.  This export
+sends each report once, as datagrams to a multicast or broadcast group, so
+any number of listeners on the LAN cost the daemon nothing extra.  The
+price is UDP's: no commands, no per-client policy, and datagrams may be
+lost.
+
+   Each datagram begins with a header line
+
+      {"class":"UDP","device":"/dev/ttyUSB0","seq":42}
+
+followed by one or more complete JSON reports from that device, each
+terminated by CR-LF as on the TCP port.  seq counts datagrams per device,
+so a receiver that sees it skip knows how many it missed.  Reports are
+packed into datagrams of at most UDP_PAYLOAD bytes to stay clear of IP
+fragmentation; a report longer than that goes out alone.
+
+PERMISSIONS
+   This file is Copyright (c) 2010-2020 by the GPSD project
+   SPDX-License-Identifier: BSD-2-clause
+
+***************************************************************************/
+
+#include "gpsd_config.h"
+
+#if defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gpsd.h"
+#include "gps_json.h"
+#include "strfuncs.h"
+
+/* Ethernet MTU less IPv6 and UDP headers */
+#define UDP_PAYLOAD	1452
+
+static bool all_digits(const char *s)
+/* is s a nonempty string of decimal digits, such as a port number? */
+{
+    return '\0' != *s && strlen(s) == strspn(s, "0123456789");
+}
+
+bool udp_acquire(struct gps_context_t *context, const char *spec)
+/* open the export socket; spec is group[:port].  An IPv6 group with a
+ * port goes in brackets; a bare one, such as ff02::1, takes no port */
+{
+    char host[NI_MAXHOST];
+    const char *port = DEFAULT_GPSD_PORT;
+    struct addrinfo hints, *result;
+    char *colon;
+    int fd, one = 1, status;
+
+    (void)strlcpy(host, spec, sizeof(host));
+    if ('[' == host[0]) {
+	char *bracket = strchr(host, ']');
+
+	if (NULL == bracket) {
+	    GPSD_LOG(LOG_ERROR, &context->errout,
+		     "UDP export: malformed group %s\n", spec);
+	    return false;
+	}
+	*bracket = '\0';
+	if (':' == bracket[1])
+	    port = spec + (bracket - host) + 2;
+	if (('\0' != bracket[1] && ':' != bracket[1])
+	    || (':' == bracket[1] && !all_digits(port))) {
+	    GPSD_LOG(LOG_ERROR, &context->errout,
+		     "UDP export: malformed group %s\n", spec);
+	    return false;
+	}
+	(void)memmove(host, host + 1, strlen(host));
+    } else if (NULL != (colon = strrchr(host, ':'))
+	       && colon == strchr(host, ':')
+	       && all_digits(colon + 1)) {
+	*colon = '\0';
+	port = spec + (colon - host) + 1;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    if (0 != (status = getaddrinfo(host, port, &hints, &result))) {
+	GPSD_LOG(LOG_ERROR, &context->errout,
+		 "UDP export: can't resolve %s: %s\n",
+		 spec, gai_strerror(status));
+	return false;
+    }
+    fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (0 > fd) {
+	GPSD_LOG(LOG_ERROR, &context->errout,
+		 "UDP export: socket: %s\n", strerror(errno));
+	freeaddrinfo(result);
+	return false;
+    }
+    /* harmless on a multicast group, required for a broadcast address */
+    (void)setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+    /* a connected socket lets udp_update() use plain send() */
+    if (0 != connect(fd, result->ai_addr, result->ai_addrlen)) {
+	GPSD_LOG(LOG_ERROR, &context->errout,
+		 "UDP export: connect to %s: %s\n", spec, strerror(errno));
+	freeaddrinfo(result);
+	(void)close(fd);
+	return false;
+    }
+    freeaddrinfo(result);
+    context->udpfd = fd;
+    GPSD_LOG(LOG_PROG, &context->errout,
+	     "UDP export to %s port %s on fd %d\n", host, port, fd);
+    return true;
+}
+
+void udp_release(struct gps_context_t *context)
+/* close the export socket */
+{
+    if (0 > context->udpfd)
+	return;
+    (void)close(context->udpfd);
+    context->udpfd = -1;
+}
+
+static void udp_ship(struct gps_context_t *context,
+		     struct gps_device_t *device,
+		     char *dgram, size_t hdrlen, size_t len)
+/* stamp the header into dgram and send it */
+{
+    char hdr[GPS_PATH_MAX + 64];
+    size_t n;
+
+    n = (size_t)snprintf(hdr, sizeof(hdr),
+			 "{\"class\":\"UDP\",\"device\":\"%s\",\"seq\":%u}\r\n",
+			 device->gpsdata.dev.path, device->udpseq++);
+    /* the header was sized generously; right-align it against the data */
+    memcpy(dgram + hdrlen - n, hdr, n);
+    /* nobody listening is not an error for a fire-and-forget export */
+    if (0 > send(context->udpfd, dgram + hdrlen - n, len - hdrlen + n, 0)
+	&& ECONNREFUSED != errno)
+	GPSD_LOG(LOG_IO, &context->errout,
+		 "UDP export: send: %s\n", strerror(errno));
+}
+
+void udp_update(struct gps_context_t *context, struct gps_device_t *device,
+		const char *buf, size_t len)
+/* export a buffer of CR-LF terminated JSON reports from one device */
+{
+    char dgram[GPS_PATH_MAX + 64 + GPS_JSON_RESPONSE_MAX * 4];
+    const size_t hdrlen = GPS_PATH_MAX + 64;
+    /* room for data once the header is in, give or take the seq digits */
+    const size_t room = UDP_PAYLOAD - 64 - strlen(device->gpsdata.dev.path);
+    size_t used = hdrlen;
+
+    if (0 > context->udpfd)
+	return;
+
+    while (0 < len) {
+	const char *eol = memchr(buf, '\n', len);
+	size_t n = (NULL == eol) ? len : (size_t)(eol - buf) + 1;
+
+	/* start a new datagram if this report won't fit in the current one */
+	if (hdrlen < used && room < used - hdrlen + n) {
+	    udp_ship(context, device, dgram, hdrlen, used);
+	    used = hdrlen;
+	}
+	if (sizeof(dgram) < used + n)
+	    break;		/* can't happen with json_data_report() output */
+	memcpy(dgram + used, buf, n);
+	used += n;
+	buf += n;
+	len -= n;
+    }
+    if (hdrlen < used)
+	udp_ship(context, device, dgram, hdrlen, used);
+}
+
+#endif /* defined(UDP_EXPORT_ENABLE) && defined(SOCKET_EXPORT_ENABLE) */
+
+/* end */